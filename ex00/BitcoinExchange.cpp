@@ -1,22 +1,50 @@
 
 #include "BitcoinExchange.hpp"
 
-#include <fstream>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <fcntl.h>
+#include <functional>
 #include <iostream>
-#include <regex>
-#include <sstream>
+#include <memory>
+#include <mutex>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
+#include "ExchangeStats.hpp"
+#include "FixedPoint.hpp"
+#include "RateSnapshot.hpp"
+#include "ThreadPool.hpp"
 
-bool BitcoinExchange::isValidDate(const std::string& date) {
-	static const std::regex datePattern(R"((\d{4})-(\d{2})-(\d{2}))");
-	std::smatch match;
-	if (!std::regex_match(date, match, datePattern)) {
+
+static bool isDigit(const char c) {
+	return c >= '0' && c <= '9';
+}
+
+// Parses a YYYY-MM-DD date into a packed yyyymmdd key, so that keys compare like the dates they encode
+bool BitcoinExchange::parseDate(const std::string_view date, int &key) {
+	if (date.size() != 10 || date[4] != '-' || date[7] != '-') {
 		return false;
 	}
+	for (const size_t i: { 0, 1, 2, 3, 5, 6, 8, 9 }) {
+		if (!isDigit(date[i])) {
+			return false;
+		}
+	}
 
-	const int year = std::stoi(match[1].str());
-	const int month = std::stoi(match[2].str());
-	const int day = std::stoi(match[3].str());
+	const int year = (date[0] - '0') * 1000 + (date[1] - '0') * 100 + (date[2] - '0') * 10 + (date[3] - '0');
+	const int month = (date[5] - '0') * 10 + (date[6] - '0');
+	const int day = (date[8] - '0') * 10 + (date[9] - '0');
 
 	if (month < 1 || month > 12) {
 		return false;
@@ -35,141 +63,1004 @@ bool BitcoinExchange::isValidDate(const std::string& date) {
 		return false;
 	}
 
+	key = year * 10000 + month * 100 + day;
 	return true;
 }
 
-bool BitcoinExchange::isValidExchangeRate(const std::string& rate) {
-	const std::regex ratePattern(R"(\d+(\.\d+)?)");
-	return std::regex_match(rate, ratePattern);
+std::string BitcoinExchange::formatDate(const int key) {
+	std::string date;
+	appendDate(date, key);
+	return date;
 }
 
-std::map<std::string, double> BitcoinExchange::_parseExchangeRates() {
-	std::ifstream exchangeRates(EXCHANGE_RATES_FILE);
-	if (!exchangeRates) {
+// Equivalent to matching \d+(\.\d+)?
+bool BitcoinExchange::isValidExchangeRate(const std::string_view rate) {
+	size_t i = 0;
+	while (i < rate.size() && isDigit(rate[i])) {
+		++i;
+	}
+	if (i == 0) {
+		return false;
+	}
+	if (i == rate.size()) {
+		return true;
+	}
+	if (rate[i] != '.' || ++i == rate.size()) {
+		return false;
+	}
+	while (i < rate.size() && isDigit(rate[i])) {
+		++i;
+	}
+	return i == rate.size();
+}
+
+// std::stod throws out_of_range for a result that underflows to a subnormal, which std::from_chars returns
+static bool isSubnormal(const double value) {
+	return std::fpclassify(value) == FP_SUBNORMAL;
+}
+
+// Accepts what std::stod accepts: leading whitespace, a sign, decimal or hex digits, inf and nan,
+// with trailing characters ignored
+bool BitcoinExchange::parseValue(std::string_view str, double &value) {
+	while (!str.empty() && std::isspace(static_cast<unsigned char>(str.front()))) {
+		str.remove_prefix(1);
+	}
+
+	bool negative = false;
+	if (!str.empty() && (str.front() == '+' || str.front() == '-')) {
+		negative = str.front() == '-';
+		str.remove_prefix(1);
+		if (!str.empty() && (str.front() == '+' || str.front() == '-')) {
+			return false;
+		}
+	}
+
+	const char *end = str.data() + str.size();
+	std::from_chars_result result = { str.data(), std::errc::invalid_argument };
+	if (str.size() > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+		result = std::from_chars(str.data() + 2, end, value, std::chars_format::hex);
+	}
+	if (result.ec == std::errc::invalid_argument) {
+		result = std::from_chars(str.data(), end, value);
+	}
+	if (result.ec != std::errc() || isSubnormal(value)) {
+		return false;
+	}
+
+	if (negative) {
+		value = -value;
+	}
+	return true;
+}
+
+// Parses one data row; throws with the message the whole-file parse has always used
+void BitcoinExchange::_parseRateLine(const std::string_view line, int &key, double &rate) {
+	const size_t delimiterPos = line.find(',');
+	if (delimiterPos == std::string_view::npos || delimiterPos + 1 == line.size()) {
+		throw std::runtime_error("Error: Invalid line format");
+	}
+
+	const std::string_view date = line.substr(0, delimiterPos);
+	const std::string_view rateStr = line.substr(delimiterPos + 1);
+
+	if (!parseDate(date, key) || !isValidExchangeRate(rateStr)) {
+		throw std::runtime_error("Error: Invalid date or exchange rate format");
+	}
+
+	// Digits alone can still be too large for a double, which leaves rate unset, or too small for a normal one
+	if (std::from_chars(rateStr.data(), rateStr.data() + rateStr.size(), rate).ec != std::errc()
+	    || isSubnormal(rate)) {
+		throw std::runtime_error("Error: Invalid date or exchange rate format");
+	}
+}
+
+RateTable BitcoinExchange::_parseExchangeRates(uint64_t *parsedBytes) {
+	LineReader exchangeRates(EXCHANGE_RATES_FILE);
+	if (!exchangeRates.isOpen()) {
 		throw std::runtime_error("Error: Could not open file " + std::string(EXCHANGE_RATES_FILE));
 	}
 
-	if (exchangeRates.peek() == std::ifstream::traits_type::eof()) {
+	if (exchangeRates.isEmpty()) {
 		throw std::runtime_error("Error: File " + std::string(EXCHANGE_RATES_FILE) + " is empty");
 	}
 
-	std::map<std::string, double> data;
-	std::string line;
-	std::getline(exchangeRates, line);
+	RateTable data;
+	std::string_view line;
+	exchangeRates.nextLine(line);
 
 	if (line != EXCHANGE_RATES_FILE_HEADER) {
 		throw std::runtime_error("Error: Invalid header in file " + std::string(EXCHANGE_RATES_FILE));
 	}
 
-	while (std::getline(exchangeRates, line)) {
-		std::istringstream ss(line);
-		std::string date, rateStr;
-		if (!std::getline(ss, date, ',') || !std::getline(ss, rateStr)) {
-			throw std::runtime_error("Error: Invalid line format");
+	while (exchangeRates.nextLine(line)) {
+		int key;
+		double rate;
+		_parseRateLine(line, key, rate);
+		if (!data.append(key, rate)) {
+			throw std::runtime_error("Error: Duplicate date found");
 		}
+	}
 
-		if (!isValidDate(date) || !isValidExchangeRate(rateStr)) {
-			throw std::runtime_error("Error: Invalid date or exchange rate format");
-		}
+	if (parsedBytes) {
+		*parsedBytes = exchangeRates.offset();
+	}
+	data.finalize();
+	return data;
 
-		double rate = std::stod(rateStr);
-		if (data.find(date) != data.end()) {
-			throw std::runtime_error("Error: Duplicate date found");
+}
+
+RateTable BitcoinExchange::_loadExchangeRates(const ExchangeOptions &options, uint64_t *sourceBytes) {
+	struct stat source = {};
+	const bool haveSource = options.useSnapshot && stat(EXCHANGE_RATES_FILE, &source) == 0;
+
+	RateTable table;
+	if (haveSource && RateSnapshot::load(EXCHANGE_RATES_SNAPSHOT_FILE, source, table)) {
+		if (sourceBytes) {
+			*sourceBytes = static_cast<uint64_t>(source.st_size);
 		}
+		return table;
+	}
 
-		data[date] = rate;
+	table = _parseExchangeRates(sourceBytes);
+	if (haveSource) {
+		// Best effort: without a snapshot the next run simply parses the CSV again. The day-indexed table
+		// goes into it too, so that runs using it do not rebuild it.
+		table.buildDenseIndex();
+		RateSnapshot::write(EXCHANGE_RATES_SNAPSHOT_FILE, source, table);
 	}
+	return table;
+}
 
-	exchangeRates.close();
-	return data;
+// Keeps the day-indexed table that came with the rows, builds it if missing, or drops it
+void BitcoinExchange::_prepareDenseIndex(RateTable &table, const ExchangeOptions &options) {
+	if (!options.denseLookup) {
+		table.dropDenseIndex();
+	} else if (!table.hasDenseIndex()) {
+		table.buildDenseIndex();
+	}
+}
 
+RateTable BitcoinExchange::loadExchangeRates(const ExchangeOptions &options) {
+	RateTable exchangeRates = _loadExchangeRates(options);
+	_prepareDenseIndex(exchangeRates, options);
+	if (options.fixedPoint) {
+		exchangeRates.buildFixedRates();
+	}
+	return exchangeRates;
 }
 
-void BitcoinExchange::printResult(const std::string &inputFileName) {
-	std::map<std::string, double> exchangeRates;
+namespace {
+	// Adds the lifetime of the object to the total time of stats, if any
+	class TotalTimer {
+		ExchangeStats *_stats;
+		ExchangeStats::Clock::time_point _start;
+
+	public:
+		explicit TotalTimer(ExchangeStats *stats) : _stats(stats), _start(ExchangeStats::Clock::now()) {}
+
+		~TotalTimer() {
+			if (_stats) {
+				_stats->addTotal(ExchangeStats::Clock::now() - _start);
+			}
+		}
+
+		TotalTimer(const TotalTimer &other) = delete;
+
+		TotalTimer &operator=(const TotalTimer &other) = delete;
+	};
+}
+
+void BitcoinExchange::printResult(const std::string &inputFileName, const ExchangeOptions &options) {
+	const TotalTimer totalTimer(options.stats);
+	RateTable exchangeRates;
 	try {
-		exchangeRates = _parseExchangeRates();
+		const ExchangeStats::Clock::time_point start = ExchangeStats::Clock::now();
+		exchangeRates = loadExchangeRates(options);
+		if (options.stats) {
+			options.stats->lap(ExchangeStats::Load, start);
+			options.stats->setRateRows(exchangeRates.size());
+		}
 	} catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;
 		return;
 	}
 
-	std::ifstream inputFile(inputFileName);
-	if (!inputFile) {
+	LineReader inputFile(inputFileName);
+	if (!inputFile.isOpen()) {
 		std::cerr << "Error: Could not open file " << inputFileName << std::endl;
 		return;
 	}
 
-	if (inputFile.peek() == std::ifstream::traits_type::eof()) {
+	if (inputFile.isEmpty()) {
 		std::cerr << "Error: File " << inputFileName << " is empty" << std::endl;
 		return;
 	}
 
-	std::string line;
-	std::getline(inputFile, line);
+	std::string_view line;
+	inputFile.nextLine(line);
 
 	if (line != INPUT_FILE_HEADER) {
 		std::cerr << "Error: Invalid header in file " << inputFileName << std::endl;
 		return;
 	}
 
-	while (std::getline(inputFile, line)) {
-		std::istringstream ss(line);
-		std::string date, valueStr;
-		size_t delimiterPos = line.find(" | ");
-		if (delimiterPos == std::string::npos) {
-			std::cerr << "Error: Invalid line format:" << std::endl;
-			continue;
+	OutputStage output(options.flushPolicy);
+	if (options.batch) {
+		_processBatch(inputFile, exchangeRates, output, options.stats);
+	} else if (options.threads > 1) {
+		_processParallel(inputFile, exchangeRates, options.threads, output, options.stats);
+	} else if (options.stats) {
+		_processInstrumented(inputFile, exchangeRates, output, *options.stats);
+	} else {
+		std::string rangeText;
+		while (inputFile.nextLine(line)) {
+			if (isRangeQuery(line)) {
+				rangeText.clear();
+				const LineStatus status = appendRangeQuery(line, exchangeRates, rangeText);
+				output.write(status == LineStatus::Ok ? OutputStage::Out : OutputStage::Err, rangeText);
+				continue;
+			}
+			int key = 0;
+			double value = 0;
+			size_t index = 0;
+			const LineStatus status = resolveLine(line, exchangeRates, key, value, index);
+			const OutputStage::Stream stream = status == LineStatus::Ok ? OutputStage::Out : OutputStage::Err;
+			appendLine(status, key, value, exchangeRates, index, output.buffer(stream));
+			output.commit(stream);
 		}
+	}
+	const ExchangeStats::Clock::time_point flushStart = ExchangeStats::Clock::now();
+	output.flush();
+	if (options.stats) {
+		options.stats->lap(ExchangeStats::Output, flushStart);
+	}
+}
+
+// Same digits as operator<< with the default precision, which formats like printf's %g
+static void appendNumber(std::string &text, const double number) {
+	char buffer[32];
+	const std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), number,
+	                                                  std::chars_format::general, 6);
+	text.append(buffer, result.ptr);
+}
+
+void BitcoinExchange::appendDate(std::string &text, const int key) {
+	const size_t start = text.size();
+	text += "0000-00-00";
+	int rest = key;
+	for (const size_t i: { 9, 8, 6, 5, 3, 2, 1, 0 }) {
+		text[start + i] = static_cast<char>('0' + rest % 10);
+		rest /= 10;
+	}
+}
+
+BitcoinExchange::LineStatus BitcoinExchange::parseLine(const std::string_view line, int &key, double &value) {
+	const size_t delimiterPos = line.find(" | ");
+	if (delimiterPos == std::string_view::npos) {
+		return LineStatus::InvalidFormat;
+	}
+
+	const std::string_view date = line.substr(0, delimiterPos);
+	const std::string_view valueStr = line.substr(delimiterPos + 3); // 3 is the length of " | "
+
+	if (!parseDate(date, key)) {
+		return LineStatus::InvalidDate;
+	}
+
+	if (!parseValue(valueStr, value)) {
+		return LineStatus::InvalidValue;
+	}
+
+	if (value < 0 || value > 1000) {
+		return LineStatus::OutOfRange;
+	}
+	return LineStatus::Ok;
+}
+
+void BitcoinExchange::appendError(const LineStatus status, const int key, std::string &text) {
+	switch (status) {
+		case LineStatus::InvalidFormat:
+			text += "Error: Invalid line format:\n";
+			break;
+		case LineStatus::InvalidDate:
+			text += "Error: Invalid date format\n";
+			break;
+		case LineStatus::InvalidValue:
+			text += "Error: Invalid value format\n";
+			break;
+		case LineStatus::OutOfRange:
+			text += "Error: Value must be between 0 and 1000\n";
+			break;
+		case LineStatus::RateNotFound:
+			text += "Error: Exchange rate not found for date ";
+			appendDate(text, key);
+			text += '\n';
+			break;
+		case LineStatus::InvalidRange:
+			text += "Error: Date range ends before it starts\n";
+			break;
+		case LineStatus::Ok:
+			break;
+	}
+}
+
+void BitcoinExchange::appendResult(const int key, const double value, const RateTable &exchangeRates,
+                                   const size_t index, std::string &text) {
+	// A value with more decimals than the fixed-point format holds keeps the double formatting, as the --fixed
+	// usage says, rather than being rounded into an exact-looking result
+	uint32_t valueUnits;
+	if (exchangeRates.hasFixedRates() && FixedPoint::toUnits(value, FIXED_VALUE_SCALE, valueUnits)) {
+		const uint64_t product = FixedPoint::multiply(valueUnits, exchangeRates.fixedRates()[index]);
+		appendFixedResult(key, valueUnits, product, exchangeRates, index, text);
+		return;
+	}
+
+	appendDate(text, key);
+	text += " => ";
+	appendNumber(text, value);
+	text += " = ";
+	appendNumber(text, value * exchangeRates.rateAt(index));
+	if (exchangeRates.dateAt(index) != key) {
+		text += " (date used: ";
+		appendDate(text, exchangeRates.dateAt(index));
+		text += ')';
+	}
+	text += '\n';
+}
+
+// appendResult with the exact decimal value and product instead of 6 significant digits
+void BitcoinExchange::appendFixedResult(const int key, const uint32_t valueUnits, const uint64_t product,
+                                        const RateTable &exchangeRates, const size_t index, std::string &text) {
+	appendDate(text, key);
+	text += " => ";
+	FixedPoint::appendUnits(text, valueUnits, FIXED_VALUE_DECIMALS);
+	text += " = ";
+	FixedPoint::appendUnits(text, product, FIXED_VALUE_DECIMALS + FIXED_RATE_DECIMALS);
+	if (exchangeRates.dateAt(index) != key) {
+		text += " (date used: ";
+		appendDate(text, exchangeRates.dateAt(index));
+		text += ')';
+	}
+	text += '\n';
+}
+
+// Validates a line and looks up its rate; index is only set when the result is Ok
+BitcoinExchange::LineStatus BitcoinExchange::resolveLine(const std::string_view line, const RateTable &exchangeRates,
+                                                         int &key, double &value, size_t &index) {
+	const LineStatus status = parseLine(line, key, value);
+	if (status != LineStatus::Ok) {
+		return status;
+	}
+	index = exchangeRates.findClosestEarlier(key);
+	return index == exchangeRates.size() ? LineStatus::RateNotFound : LineStatus::Ok;
+}
+
+// Appends the output for one resolved line, newline included, to text
+void BitcoinExchange::appendLine(const LineStatus status, const int key, const double value,
+                                 const RateTable &exchangeRates, const size_t index, std::string &text) {
+	if (status == LineStatus::Ok) {
+		appendResult(key, value, exchangeRates, index, text);
+	} else {
+		appendError(status, key, text);
+	}
+}
+
+BitcoinExchange::LineStatus BitcoinExchange::resolveRange(const std::string_view line, const RateTable &exchangeRates,
+                                                          int &from, int &to, double &value, size_t &first,
+                                                          size_t &last) {
+	const size_t delimiterPos = line.find(" | ");
+	if (delimiterPos == std::string_view::npos) {
+		return LineStatus::InvalidFormat;
+	}
+
+	// Two dates of 10 characters around the separator
+	const std::string_view dates = line.substr(0, delimiterPos);
+	if (dates.size() != 22 || !parseDate(dates.substr(0, 10), from) || !parseDate(dates.substr(12), to)) {
+		return LineStatus::InvalidDate;
+	}
+
+	if (!parseValue(line.substr(delimiterPos + 3), value)) {
+		return LineStatus::InvalidValue;
+	}
+
+	if (value < 0 || value > 1000) {
+		return LineStatus::OutOfRange;
+	}
+
+	if (to < from) {
+		return LineStatus::InvalidRange;
+	}
+
+	first = exchangeRates.findClosestEarlier(from);
+	if (first == exchangeRates.size()) {
+		return LineStatus::RateNotFound;
+	}
+	last = exchangeRates.findClosestEarlier(to);
+	return LineStatus::Ok;
+}
+
+// "from..to => value = avg A, min B, max C (N rates)", each aggregate multiplied by value
+void BitcoinExchange::appendRange(const LineStatus status, const int from, const int to, const double value,
+                                  const RateTable &exchangeRates, const size_t first, const size_t last,
+                                  std::string &text) {
+	if (status != LineStatus::Ok) {
+		appendError(status, from, text);
+		return;
+	}
+
+	double average, min, max;
+	exchangeRates.aggregate(first, last, average, min, max);
+	const size_t count = last - first + 1;
+
+	appendDate(text, from);
+	text += RANGE_SEPARATOR;
+	appendDate(text, to);
+	text += " => ";
+	appendNumber(text, value);
+	text += " = avg ";
+	appendNumber(text, value * average);
+	text += ", min ";
+	appendNumber(text, value * min);
+	text += ", max ";
+	appendNumber(text, value * max);
+	text += " (";
+	char buffer[24];
+	text.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), count).ptr);
+	text += count == 1 ? " rate)\n" : " rates)\n";
+}
 
-		date = line.substr(0, delimiterPos);
-		valueStr = line.substr(delimiterPos + 3); // 3 is the length of " | "
+BitcoinExchange::LineStatus BitcoinExchange::appendRangeQuery(const std::string_view line,
+                                                              const RateTable &exchangeRates, std::string &text) {
+	int from = 0;
+	int to = 0;
+	double value = 0;
+	size_t first = 0;
+	size_t last = 0;
+	const LineStatus status = resolveRange(line, exchangeRates, from, to, value, first, last);
+	appendRange(status, from, to, value, exchangeRates, first, last, text);
+	return status;
+}
 
-		if (!isValidDate(date)) {
-			std::cerr << "Error: Invalid date format" << std::endl;
+// The sequential loop of printResult, counting every line into stats and timing sampled lines phase by phase
+void BitcoinExchange::_processInstrumented(LineReader &inputFile, const RateTable &exchangeRates, OutputStage &output,
+                                           ExchangeStats &stats) {
+	std::string_view line;
+	std::string rangeText;
+	const ExchangeStats::Clock::time_point start = ExchangeStats::Clock::now();
+	ExchangeStats::Clock::time_point mark = start;
+	for (size_t lineNumber = 0;; ++lineNumber) {
+		const bool sampled = lineNumber % STATS_SAMPLE_INTERVAL == 0;
+		if (sampled) {
+			mark = ExchangeStats::Clock::now();
+		}
+		if (!inputFile.nextLine(line)) {
+			break;
+		}
+		if (isRangeQuery(line)) {
+			rangeText.clear();
+			const LineStatus status = appendRangeQuery(line, exchangeRates, rangeText);
+			stats.countRange(status);
+			output.write(status == LineStatus::Ok ? OutputStage::Out : OutputStage::Err, rangeText);
 			continue;
 		}
 
-		double value;
-		try {
-			value = std::stod(valueStr);
-		} catch (const std::exception& e) {
-			std::cerr << "Error: Invalid value format" << std::endl;
-			continue;
+		int key = 0;
+		double value = 0;
+		size_t index = 0;
+		LineStatus status = parseLine(line, key, value);
+		if (sampled) {
+			mark = stats.lapSample(ExchangeStats::Parse, mark);
+		}
+		if (status == LineStatus::Ok) {
+			index = exchangeRates.findClosestEarlier(key);
+			if (index == exchangeRates.size()) {
+				status = LineStatus::RateNotFound;
+			}
+			if (sampled) {
+				mark = stats.lapSample(ExchangeStats::Lookup, mark);
+			}
 		}
 
-		if (value < 0 || value > 1000) {
-			std::cerr << "Error: Value must be between 0 and 1000" << std::endl;
-			continue;
+		stats.countLine(status, key, exchangeRates, index);
+		const OutputStage::Stream stream = status == LineStatus::Ok ? OutputStage::Out : OutputStage::Err;
+		appendLine(status, key, value, exchangeRates, index, output.buffer(stream));
+		output.commit(stream);
+		if (sampled) {
+			stats.lapSample(ExchangeStats::Output, mark);
 		}
+	}
+	stats.addSampled(ExchangeStats::Clock::now() - start);
+}
+
+namespace {
+	struct OutputChunk {
+		std::string storage;
+		std::string_view input;
+		std::string text;
+		std::vector<std::pair<bool, size_t> > runs; // consecutive bytes of text bound for stderr (true) or stdout
+		ExchangeStats stats;
+	};
+}
+
+template<typename Format>
+static void formatChunk(OutputChunk &chunk, Format formatLine) {
+	std::string_view input = chunk.input;
+	while (!input.empty()) {
+		const size_t newline = input.find('\n');
+		const std::string_view line = input.substr(0, newline);
+		input.remove_prefix(newline == std::string_view::npos ? input.size() : newline + 1);
+
+		const size_t before = chunk.text.size();
+		const bool isError = formatLine(line, chunk.text);
+		if (!chunk.runs.empty() && chunk.runs.back().first == isError) {
+			chunk.runs.back().second += chunk.text.size() - before;
+		} else {
+			chunk.runs.emplace_back(isError, chunk.text.size() - before);
+		}
+	}
+}
+
+static void writeChunk(const OutputChunk &chunk, OutputStage &output) {
+	size_t offset = 0;
+	for (const auto &[isError, length]: chunk.runs) {
+		output.write(isError ? OutputStage::Err : OutputStage::Out, std::string_view(chunk.text).substr(offset, length));
+		offset += length;
+	}
+}
+
+// Input is cut into newline-aligned chunks that a pool formats concurrently; chunks are written back in
+// order, with at most a few per thread waiting, so memory stays bounded whatever the file size
+void BitcoinExchange::_processParallel(LineReader &inputFile, const RateTable &exchangeRates, const unsigned threads,
+                                       OutputStage &output, ExchangeStats *stats) {
+	ThreadPool pool(threads);
+	std::deque<std::pair<std::unique_ptr<OutputChunk>, std::future<void> > > inFlight;
+	const size_t window = static_cast<size_t>(threads) * 4;
+
+	for (bool more = true; more;) {
+		auto chunk = std::make_unique<OutputChunk>();
+		more = inputFile.nextChunk(PARALLEL_CHUNK_SIZE, chunk->input, chunk->storage);
+		if (more) {
+			OutputChunk *task = chunk.get();
+			const bool instrumented = stats != nullptr;
+			std::future<void> done = pool.submit([task, &exchangeRates, instrumented] {
+				const ExchangeStats::Clock::time_point start = ExchangeStats::Clock::now();
+				ExchangeStats::Clock::time_point mark = start;
+				size_t lineNumber = 0;
+				formatChunk(*task, [&](const std::string_view line, std::string &text) {
+					if (isRangeQuery(line)) {
+						const LineStatus status = appendRangeQuery(line, exchangeRates, text);
+						if (instrumented) {
+							task->stats.countRange(status);
+						}
+						return status != LineStatus::Ok;
+					}
+					const bool sampled = instrumented && lineNumber++ % STATS_SAMPLE_INTERVAL == 0;
+					if (sampled) {
+						mark = ExchangeStats::Clock::now();
+					}
+					int key = 0;
+					double value = 0;
+					size_t index = 0;
+					LineStatus status = parseLine(line, key, value);
+					if (sampled) {
+						mark = task->stats.lapSample(ExchangeStats::Parse, mark);
+					}
+					if (status == LineStatus::Ok) {
+						index = exchangeRates.findClosestEarlier(key);
+						if (index == exchangeRates.size()) {
+							status = LineStatus::RateNotFound;
+						}
+						if (sampled) {
+							mark = task->stats.lapSample(ExchangeStats::Lookup, mark);
+						}
+					}
+					if (instrumented) {
+						task->stats.countLine(status, key, exchangeRates, index);
+					}
+					appendLine(status, key, value, exchangeRates, index, text);
+					if (sampled) {
+						task->stats.lapSample(ExchangeStats::Output, mark);
+					}
+					return status != LineStatus::Ok;
+				});
+				if (instrumented) {
+					task->stats.addSampled(ExchangeStats::Clock::now() - start);
+				}
+			});
+			inFlight.emplace_back(std::move(chunk), std::move(done));
+		}
+
+		while (!inFlight.empty() && (!more || inFlight.size() >= window)) {
+			inFlight.front().second.get();
+			const ExchangeStats::Clock::time_point start = ExchangeStats::Clock::now();
+			writeChunk(*inFlight.front().first, output);
+			if (stats) {
+				stats->merge(inFlight.front().first->stats);
+				stats->lap(ExchangeStats::Output, start);
+			}
+			inFlight.pop_front();
+		}
+	}
+}
 
-		std::map<std::string, double>::const_iterator it;
-		try {
-			findExchangeRate(it, exchangeRates, date);
-		} catch (const std::exception& e) {
-			std::cerr << e.what() << std::endl;
+// Validates every line first, resolves all valid dates in one sorted merge over the table, then writes the
+// results in input order
+void BitcoinExchange::_processBatch(LineReader &inputFile, const RateTable &exchangeRates, OutputStage &output,
+                                    ExchangeStats *stats) {
+	ExchangeStats::Clock::time_point mark = ExchangeStats::Clock::now();
+	std::vector<LineStatus> statuses;
+	std::vector<int> keys;
+	std::vector<double> values;
+
+	// Range queries are answered while parsing; their output waits in rangeText for its turn
+	struct RangeOutput {
+		size_t line;
+		size_t end; // end of its output in rangeText
+		LineStatus status;
+	};
+	std::string rangeText;
+	std::vector<RangeOutput> ranges;
+
+	std::string_view line;
+	while (inputFile.nextLine(line)) {
+		int key = 0;
+		double value = 0;
+		if (isRangeQuery(line)) {
+			ranges.push_back({ statuses.size(), 0, appendRangeQuery(line, exchangeRates, rangeText) });
+			ranges.back().end = rangeText.size();
+			statuses.push_back(LineStatus::InvalidRange); // any status but Ok keeps it out of the lookup
+		} else {
+			statuses.push_back(parseLine(line, key, value));
+		}
+		keys.push_back(key);
+		values.push_back(value);
+	}
+	if (stats) {
+		mark = stats->lap(ExchangeStats::Parse, mark);
+	}
+
+	std::vector<int> queryDates;
+	for (size_t i = 0; i < statuses.size(); ++i) {
+		if (statuses[i] == LineStatus::Ok) {
+			queryDates.push_back(keys[i]);
+		}
+	}
+	std::vector<size_t> indices(queryDates.size());
+	exchangeRates.findClosestEarlierBatch(queryDates.data(), queryDates.size(), indices.data());
+	if (stats) {
+		mark = stats->lap(ExchangeStats::Lookup, mark);
+	}
+
+	// With fixed-point rates, every query whose value fits is valued in one vectorized pass; the rest keep
+	// the per-line path of appendLine
+	std::vector<uint32_t> fixedValues;
+	std::vector<uint32_t> fixedIndices;
+	std::vector<size_t> fixedLines;
+	std::vector<uint64_t> products;
+	if (exchangeRates.hasFixedRates()) {
+		size_t query = 0;
+		for (size_t i = 0; i < statuses.size(); ++i) {
+			if (statuses[i] != LineStatus::Ok) continue;
+			const size_t index = indices[query++];
+			uint32_t units;
+			if (index != exchangeRates.size() && FixedPoint::toUnits(values[i], FIXED_VALUE_SCALE, units)) {
+				fixedValues.push_back(units);
+				fixedIndices.push_back(static_cast<uint32_t>(index));
+				fixedLines.push_back(i);
+			}
+		}
+		products.resize(fixedValues.size());
+		FixedPoint::multiplyGathered(fixedValues.data(), fixedIndices.data(), exchangeRates.fixedRates(),
+		                             products.data(), products.size());
+	}
+
+	size_t query = 0;
+	size_t fixed = 0;
+	size_t range = 0;
+	for (size_t i = 0; i < statuses.size(); ++i) {
+		if (range < ranges.size() && ranges[range].line == i) {
+			const RangeOutput &answer = ranges[range];
+			const size_t start = range == 0 ? 0 : ranges[range - 1].end;
+			if (stats) {
+				stats->countRange(answer.status);
+			}
+			output.write(answer.status == LineStatus::Ok ? OutputStage::Out : OutputStage::Err,
+			             std::string_view(rangeText).substr(start, answer.end - start));
+			++range;
 			continue;
 		}
+		LineStatus status = statuses[i];
+		const size_t index = status == LineStatus::Ok ? indices[query++] : exchangeRates.size();
+		if (status == LineStatus::Ok && index == exchangeRates.size()) {
+			status = LineStatus::RateNotFound;
+		}
+		if (stats) {
+			stats->countLine(status, keys[i], exchangeRates, index);
+		}
+
+		const OutputStage::Stream stream = status == LineStatus::Ok ? OutputStage::Out : OutputStage::Err;
+		if (fixed < fixedLines.size() && fixedLines[fixed] == i) {
+			appendFixedResult(keys[i], fixedValues[fixed], products[fixed], exchangeRates, index,
+			                  output.buffer(stream));
+			++fixed;
+		} else {
+			appendLine(status, keys[i], values[i], exchangeRates, index, output.buffer(stream));
+		}
+		output.commit(stream);
+	}
+	if (stats) {
+		stats->lap(ExchangeStats::Output, mark);
+	}
+}
+
+static bool writeAll(const int fd, const std::string_view data) {
+	size_t written = 0;
+	while (written < data.size()) {
+		const ssize_t n = write(fd, data.data() + written, data.size() - written);
+		if (n == -1 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		written += static_cast<size_t>(n);
+	}
+	return true;
+}
 
-		std::cout << date << " => " << value << " = " << value * it->second;
-		if (it->first != date) {
-			std::cout << " (date used: " << it->first << ")";
+// Offset just past the last '\n' before end, found by reading the file backwards
+static uint64_t completeLinesEnd(const int fd, uint64_t end) {
+	char block[4096];
+	while (end > 0) {
+		const uint64_t start = end > sizeof(block) ? end - sizeof(block) : 0;
+		const ssize_t n = pread(fd, block, static_cast<size_t>(end - start), static_cast<off_t>(start));
+		if (n != static_cast<ssize_t>(end - start)) return 0;
+		for (uint64_t i = end - start; i > 0; --i) {
+			if (block[i - 1] == '\n') return start + i;
 		}
-		std::cout << std::endl;
+		end = start;
 	}
+	return 0;
 }
 
-void BitcoinExchange::findExchangeRate(std::map<std::string, double>::const_iterator &it, const std::map<std::string, double>& exchangeRates, const std::string& date) {
-	it = exchangeRates.lower_bound(date);
-	if (it == exchangeRates.begin() && it->first != date) {
-		throw std::runtime_error("Error: Exchange rate not found for date " + date);
+void BitcoinExchange::_loadLiveRates(LiveRates &rates, const ExchangeOptions &options) {
+	struct stat source = {};
+	stat(EXCHANGE_RATES_FILE, &source);
+
+	uint64_t loaded = 0;
+	RateTable table = _loadExchangeRates(options, &loaded);
+	_prepareDenseIndex(table, options);
+	if (options.fixedPoint) {
+		table.buildFixedRates();
 	}
 
-	if (it == exchangeRates.end() || it->first != date) {
-		--it;
+	const int fd = open(EXCHANGE_RATES_FILE, O_RDONLY);
+	rates.consumed = fd == -1 ? 0 : completeLinesEnd(fd, loaded);
+	if (fd != -1) close(fd);
+	rates.tailPending = rates.consumed < loaded && !table.empty();
+	rates.knownSize = loaded;
+	rates.device = source.st_dev;
+	rates.inode = source.st_ino;
+	rates.failedSize = -1;
+	std::atomic_store(&rates.table, std::shared_ptr<const RateTable>(std::make_shared<RateTable>(std::move(table))));
+}
+
+// Ingests the complete lines appended since the last call, validated like the initial load and required
+// to continue the date order. A replaced or truncated file is reloaded in full. On error nothing is
+// published, and the same file size is not retried.
+size_t BitcoinExchange::_refreshLiveRates(LiveRates &rates, const ExchangeOptions &options) {
+	struct stat source = {};
+	if (stat(EXCHANGE_RATES_FILE, &source) != 0 || source.st_size == rates.failedSize
+	    || static_cast<uint64_t>(source.st_size) == rates.knownSize) {
+		return 0;
 	}
 
-	if (it == exchangeRates.end() || it->first > date) {
-		throw std::runtime_error("Error: Exchange rate not found for date " + date);
+	try {
+		if (source.st_dev != rates.device || source.st_ino != rates.inode || rates.consumed == 0
+		    || static_cast<uint64_t>(source.st_size) < rates.knownSize) {
+			_loadLiveRates(rates, options);
+			return std::atomic_load(&rates.table)->size();
+		}
+
+		const int fd = open(EXCHANGE_RATES_FILE, O_RDONLY);
+		if (fd == -1) {
+			throw std::runtime_error("Error: Could not open file " + std::string(EXCHANGE_RATES_FILE));
+		}
+		std::string appended(static_cast<uint64_t>(source.st_size) - rates.consumed, '\0');
+		const ssize_t n = pread(fd, appended.data(), appended.size(), static_cast<off_t>(rates.consumed));
+		close(fd);
+		appended.resize(n > 0 ? static_cast<size_t>(n) : 0);
+
+		const size_t complete = appended.rfind('\n');
+		if (complete == std::string::npos) {
+			rates.knownSize = rates.consumed + appended.size();
+			return 0;
+		}
+
+		RateTable next = std::atomic_load(&rates.table)->clone();
+		if (rates.tailPending) {
+			next.removeLast(); // it was read before its line was complete; the full line follows
+		}
+
+		size_t added = 0;
+		std::string_view lines = std::string_view(appended).substr(0, complete + 1);
+		while (!lines.empty()) {
+			const size_t newline = lines.find('\n');
+			int key;
+			double rate;
+			_parseRateLine(lines.substr(0, newline), key, rate);
+			lines.remove_prefix(newline + 1);
+
+			if (!next.empty() && key <= next.dateAt(next.size() - 1)) {
+				throw std::runtime_error(key == next.dateAt(next.size() - 1)
+					                         ? "Error: Duplicate date found"
+					                         : "Error: Appended date " + formatDate(key) + " is out of order");
+			}
+			next.append(key, rate);
+			++added;
+		}
+		next.finalize();
+		if (options.denseLookup) {
+			next.buildDenseIndex();
+		}
+		if (options.fixedPoint) {
+			next.buildFixedRates();
+		}
+
+		std::atomic_store(&rates.table, std::shared_ptr<const RateTable>(std::make_shared<RateTable>(std::move(next))));
+		rates.consumed += complete + 1;
+		rates.tailPending = false;
+		rates.knownSize = rates.consumed + appended.size() - (complete + 1);
+		rates.failedSize = -1;
+		return added;
+	} catch (const std::exception &) {
+		rates.failedSize = source.st_size;
+		throw;
+	}
+}
+
+namespace {
+	// Calls poll every interval on its own thread, until destroyed
+	class PollingThread {
+		std::mutex _mutex;
+		std::condition_variable _cv;
+		bool _stopping = false;
+		std::thread _thread;
+
+	public:
+		PollingThread(const std::chrono::milliseconds interval, std::function<void()> poll)
+			: _thread([this, interval, poll = std::move(poll)] {
+				std::unique_lock<std::mutex> lock(_mutex);
+				while (!_cv.wait_for(lock, interval, [this] { return _stopping; })) {
+					lock.unlock();
+					poll();
+					lock.lock();
+				}
+			}) {
+		}
+
+		~PollingThread() {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stopping = true;
+			}
+			_cv.notify_all();
+			_thread.join();
+		}
+	};
+}
+
+// Answers requests as they arrive. Responses are collected while more complete requests are already
+// buffered, and written before the next read could block, so pipelined requests share one write.
+void BitcoinExchange::_serveConnection(const int inFd, const int outFd, const LiveRates &rates) {
+	LineReader requests(inFd);
+	std::string responses;
+	responses.reserve(OUTPUT_BUFFER_SIZE + 256);
+
+	std::string_view line;
+	while (requests.nextLine(line)) {
+		// Holding the table for the whole request keeps it alive across a concurrent refresh
+		const std::shared_ptr<const RateTable> exchangeRates = std::atomic_load(&rates.table);
+		if (isRangeQuery(line)) {
+			appendRangeQuery(line, *exchangeRates, responses);
+		} else {
+			int key = 0;
+			double value = 0;
+			size_t index = 0;
+			const LineStatus status = resolveLine(line, *exchangeRates, key, value, index);
+			appendLine(status, key, value, *exchangeRates, index, responses);
+		}
+
+		if (!requests.hasBufferedLine() || responses.size() >= OUTPUT_BUFFER_SIZE) {
+			if (!writeAll(outFd, responses)) return;
+			responses.clear();
+		}
+	}
+	writeAll(outFd, responses);
+}
+
+// A socket left behind by a previous server is removed, but never another kind of file, nor the socket
+// of a server that still accepts connections
+bool BitcoinExchange::_removeStaleSocket(const sockaddr_un &address) {
+	struct stat st = {};
+	if (lstat(address.sun_path, &st) != 0) {
+		return true;
+	}
+	if (!S_ISSOCK(st.st_mode)) {
+		std::cerr << "Error: " << address.sun_path << " exists and is not a socket" << std::endl;
+		return false;
+	}
+
+	const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	const bool listening = probe != -1
+	                       && connect(probe, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+	if (probe != -1) close(probe);
+	if (listening) {
+		std::cerr << "Error: Another server is listening on socket " << address.sun_path << std::endl;
+		return false;
+	}
+	if (unlink(address.sun_path) != 0) {
+		std::cerr << "Error: Could not remove stale socket " << address.sun_path << ": " << std::strerror(errno)
+				<< std::endl;
+		return false;
+	}
+	return true;
+}
+
+int BitcoinExchange::serve(const std::string &socketPath, const ExchangeOptions &options) {
+	const auto rates = std::make_shared<LiveRates>();
+	try {
+		_loadLiveRates(*rates, options);
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	std::unique_ptr<PollingThread> reloader;
+	if (options.reloadIntervalMs > 0) {
+		reloader = std::make_unique<PollingThread>(std::chrono::milliseconds(options.reloadIntervalMs), [rates, options] {
+			try {
+				_refreshLiveRates(*rates, options);
+			} catch (const std::exception& e) {
+				std::cerr << e.what() << " (keeping the previous rates)" << std::endl;
+			}
+		});
+	}
+
+	if (socketPath.empty()) {
+		_serveConnection(STDIN_FILENO, STDOUT_FILENO, *rates);
+		return 0;
+	}
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof(address.sun_path)) {
+		std::cerr << "Error: Socket path too long " << socketPath << std::endl;
+		return 1;
+	}
+	std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+	if (!_removeStaleSocket(address)) {
+		return 1;
+	}
+
+	const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener == -1 || bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1
+	    || listen(listener, SOMAXCONN) == -1) {
+		std::cerr << "Error: Could not listen on socket " << socketPath << ": " << std::strerror(errno) << std::endl;
+		if (listener != -1) close(listener);
+		return 1;
+	}
+
+	// A client that disconnects early must not take the server down with it
+	std::signal(SIGPIPE, SIG_IGN);
+
+	for (;;) {
+		const int client = accept(listener, nullptr, nullptr);
+		if (client == -1) {
+			if (errno == EINTR || errno == ECONNABORTED) continue;
+			std::cerr << "Error: Could not accept connection: " << std::strerror(errno) << std::endl;
+			close(listener);
+			return 1;
+		}
+		std::thread([client, rates] {
+			_serveConnection(client, client, *rates);
+			close(client);
+		}).detach();
 	}
 }
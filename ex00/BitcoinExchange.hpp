@@ -1,22 +1,126 @@
 #pragma once
-#include <map>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <sys/un.h>
+
+#include "LineReader.hpp"
+#include "OutputStage.hpp"
+#include "RateTable.hpp"
 
 #define EXCHANGE_RATES_FILE "./data.csv"
 #define EXCHANGE_RATES_FILE_HEADER "date,exchange_rate"
+#define EXCHANGE_RATES_SNAPSHOT_FILE "./data.csv.snapshot"
+#define PARALLEL_CHUNK_SIZE (1024 * 1024)
+#define RATE_RELOAD_INTERVAL_MS 1000
 #define INPUT_FILE_HEADER "date | value"
+#define RANGE_SEPARATOR ".."
+
+class ExchangeStats;
+
+struct ExchangeOptions {
+	bool denseLookup = true; // use a day-indexed table when the date span allows it
+	bool useSnapshot = true; // load rates from EXCHANGE_RATES_SNAPSHOT_FILE, rebuilding it when stale
+	unsigned threads = 1; // above 1, input lines are processed in parallel chunks
+	bool batch = false; // resolve all queries in one sort-merge pass before writing any output
+	// Value with exact decimals when all rates fit, see FixedPoint.hpp. Lines whose value has more than
+	// FIXED_VALUE_DECIMALS decimals keep the default 6 significant digits.
+	bool fixedPoint = false;
+	FlushPolicy flushPolicy = FlushPolicy::Auto;
+	unsigned reloadIntervalMs = RATE_RELOAD_INTERVAL_MS; // how often a server looks for appended rates; 0 never
+	ExchangeStats *stats = nullptr; // when set, printResult adds its phase times and line counts to it
+};
 
 class BitcoinExchange {
-	std::map<std::string, double> _exchangeRates;
+public:
+	enum class LineStatus : unsigned char {
+		Ok,
+		InvalidFormat,
+		InvalidDate,
+		InvalidValue,
+		OutOfRange,
+		RateNotFound,
+		InvalidRange
+	};
+
+private:
+	// Rates of a long-running exchange, following appends to EXCHANGE_RATES_FILE. Readers take the table with
+	// std::atomic_load and keep it as long as they need it; a refresh builds a complete new table and
+	// publishes it with std::atomic_store, so readers never wait and never see a half-updated table.
+	struct LiveRates {
+		std::shared_ptr<const RateTable> table;
+		uint64_t consumed = 0; // offset just past the last complete line ingested
+		uint64_t knownSize = 0; // file size seen by the last load or refresh
+		bool tailPending = false; // the last row came from a line without its '\n' yet
+		dev_t device = 0;
+		ino_t inode = 0;
+		off_t failedSize = -1; // file size at which the last refresh failed
+	};
+
+	RateTable _exchangeRates;
+
+	static bool parseDate(std::string_view date, int &key);
+
+	static std::string formatDate(int key);
+
+	static void appendDate(std::string &text, int key);
+
+	static bool isValidExchangeRate(std::string_view rate);
+
+	static bool parseValue(std::string_view str, double &value);
+
+	static void _parseRateLine(std::string_view line, int &key, double &rate);
+
+	static RateTable _parseExchangeRates(uint64_t *parsedBytes = nullptr);
+
+	static RateTable _loadExchangeRates(const ExchangeOptions &options, uint64_t *sourceBytes = nullptr);
+
+	static void _prepareDenseIndex(RateTable &table, const ExchangeOptions &options);
 
-	static bool isValidDate(const std::string &date);
+	static void _loadLiveRates(LiveRates &rates, const ExchangeOptions &options);
 
-	static bool isValidExchangeRate(const std::string &rate);
+	static size_t _refreshLiveRates(LiveRates &rates, const ExchangeOptions &options);
 
-	static std::map<std::string, double> _parseExchangeRates();
+	static void appendError(LineStatus status, int key, std::string &text);
 
-	static void findExchangeRate(std::map<std::string, double>::const_iterator &it, const std::map<std::string, double> &exchangeRates, const std::
-	                             string &date);
+	static void appendResult(int key, double value, const RateTable &exchangeRates, size_t index, std::string &text);
+
+	static void appendFixedResult(int key, uint32_t valueUnits, uint64_t product, const RateTable &exchangeRates,
+	                              size_t index, std::string &text);
+
+	// Range queries ("YYYY-MM-DD..YYYY-MM-DD | value") aggregate the rates in effect from the first date to the
+	// last one. Any line with the separator right after a date is one, so it never matches a plain query.
+	static bool isRangeQuery(std::string_view line) {
+		return line.size() > 12 && line[10] == RANGE_SEPARATOR[0] && line[11] == RANGE_SEPARATOR[1];
+	}
+
+	// Validates a range query and finds its first and last rows; they are only set when the result is Ok
+	static LineStatus resolveRange(std::string_view line, const RateTable &exchangeRates, int &from, int &to,
+	                               double &value, size_t &first, size_t &last);
+
+	static void appendRange(LineStatus status, int from, int to, double value, const RateTable &exchangeRates,
+	                        size_t first, size_t last, std::string &text);
+
+	// resolveRange and appendRange in one call
+	static LineStatus appendRangeQuery(std::string_view line, const RateTable &exchangeRates, std::string &text);
+
+	static LineStatus resolveLine(std::string_view line, const RateTable &exchangeRates, int &key, double &value,
+	                              size_t &index);
+
+	static void _processInstrumented(LineReader &inputFile, const RateTable &exchangeRates, OutputStage &output,
+	                                 ExchangeStats &stats);
+
+	static void _processParallel(LineReader &inputFile, const RateTable &exchangeRates, unsigned threads,
+	                             OutputStage &output, ExchangeStats *stats);
+
+	static void _processBatch(LineReader &inputFile, const RateTable &exchangeRates, OutputStage &output,
+	                          ExchangeStats *stats);
+
+	static void _serveConnection(int inFd, int outFd, const LiveRates &rates);
+
+	static bool _removeStaleSocket(const sockaddr_un &address);
 
 public:
 	BitcoinExchange() = delete;
@@ -27,5 +131,19 @@ public:
 
 	BitcoinExchange &operator=(const BitcoinExchange &other) = delete;
 
-	static void printResult(const std::string &inputFileName);
+	// The stages of printResult, one at a time, for tools that measure them separately.
+	// loadExchangeRates throws std::runtime_error on an unusable rates file.
+	static RateTable loadExchangeRates(const ExchangeOptions &options = ExchangeOptions());
+
+	static LineStatus parseLine(std::string_view line, int &key, double &value);
+
+	static void appendLine(LineStatus status, int key, double value, const RateTable &exchangeRates, size_t index,
+	                       std::string &text);
+
+	static void printResult(const std::string &inputFileName, const ExchangeOptions &options = ExchangeOptions());
+
+	// Loads the rates once, then answers "date | value" lines from stdin (empty socketPath) or from any
+	// number of clients of a Unix domain socket. Each request gets exactly one response line, errors
+	// included, on the same stream. Only returns on EOF of stdin or on a fatal error.
+	static int serve(const std::string &socketPath, const ExchangeOptions &options = ExchangeOptions());
 };
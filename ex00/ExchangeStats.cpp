@@ -0,0 +1,98 @@
+#include "ExchangeStats.hpp"
+
+static const char *const statusNames[] = {
+	"ok",
+	"invalid_format",
+	"invalid_date",
+	"invalid_value",
+	"out_of_range",
+	"rate_not_found",
+	"invalid_range"
+};
+
+static const char *const phaseNames[] = { "load", "parse", "lookup", "output" };
+
+void ExchangeStats::countLine(const BitcoinExchange::LineStatus status, const int key,
+                              const RateTable &exchangeRates, const size_t index) {
+	++_lines;
+	++_statuses[static_cast<size_t>(status)];
+	if (status != BitcoinExchange::LineStatus::Ok) {
+		return;
+	}
+
+	const int days = exchangeRates.dateAt(index) == key
+		? 0 : RateTable::daysFromDate(key) - RateTable::daysFromDate(exchangeRates.dateAt(index));
+	size_t bucket = 0;
+	while (bucket + 1 < STATS_FALLBACK_BUCKETS && days >= 1 << bucket) {
+		++bucket;
+	}
+	++_fallbackDays[bucket];
+}
+
+void ExchangeStats::addSampled(const Clock::duration elapsed) {
+	Clock::duration sampled = {};
+	for (const Clock::duration &sample: _samples) {
+		sampled += sample;
+	}
+	for (size_t i = 0; i < PhaseCount; ++i) {
+		if (sampled.count() > 0) {
+			_phases[i] += Clock::duration(static_cast<Clock::rep>(
+				static_cast<double>(elapsed.count()) * static_cast<double>(_samples[i].count())
+				/ static_cast<double>(sampled.count())));
+		}
+		_samples[i] = {};
+	}
+}
+
+void ExchangeStats::countRange(const BitcoinExchange::LineStatus status) {
+	++_lines;
+	++_ranges;
+	++_statuses[static_cast<size_t>(status)];
+}
+
+void ExchangeStats::merge(const ExchangeStats &other) {
+	for (size_t i = 0; i < PhaseCount; ++i) {
+		_phases[i] += other._phases[i];
+	}
+	_total += other._total;
+	_lines += other._lines;
+	_ranges += other._ranges;
+	for (size_t i = 0; i < StatusCount; ++i) {
+		_statuses[i] += other._statuses[i];
+	}
+	for (size_t i = 0; i < STATS_FALLBACK_BUCKETS; ++i) {
+		_fallbackDays[i] += other._fallbackDays[i];
+	}
+	_rateRows += other._rateRows;
+}
+
+void ExchangeStats::writeJson(std::ostream &out) const {
+	typedef std::chrono::duration<double> Seconds;
+
+	out << "{\n  \"seconds\": {";
+	for (size_t i = 0; i < PhaseCount; ++i) {
+		out << '"' << phaseNames[i] << "\": " << Seconds(_phases[i]).count() << ", ";
+	}
+	out << "\"total\": " << Seconds(_total).count() << "},\n";
+
+	out << "  \"rate_rows\": " << _rateRows << ",\n";
+	out << "  \"lines\": " << _lines << ",\n  \"range_queries\": " << _ranges << ",\n  \"results\": {";
+	for (size_t i = 0; i < StatusCount; ++i) {
+		out << (i ? ", " : "") << '"' << statusNames[i] << "\": " << _statuses[i];
+	}
+	out << "},\n";
+
+	// Each bucket covers [min, max] days; the last one has no upper bound
+	out << "  \"fallback_days\": [";
+	for (size_t i = 0; i < STATS_FALLBACK_BUCKETS; ++i) {
+		const uint64_t min = i == 0 ? 0 : uint64_t(1) << (i - 1);
+		out << (i ? ",\n    " : "\n    ") << "{\"min\": " << min << ", \"max\": ";
+		if (i + 1 < STATS_FALLBACK_BUCKETS) {
+			out << (i == 0 ? 0 : (min << 1) - 1);
+		} else {
+			out << "null";
+		}
+		out << ", \"count\": " << _fallbackDays[i] << '}';
+	}
+	out << "\n  ]\n}\n";
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#include "BitcoinExchange.hpp"
+
+// Only one line in this many is timed phase by phase, which keeps clock reads off the per-line cost
+#define STATS_SAMPLE_INTERVAL 32
+
+// Power-of-two buckets of days between a query and the rate used for it: 0, 1, 2-3, 4-7, ... and the rest
+#define STATS_FALLBACK_BUCKETS 16
+
+// Opt-in counters for one printResult run, filled in when ExchangeOptions::stats points at an instance.
+// Per-line phases are timed on sampled lines only, and the measured time of the whole loop is split in
+// the same proportions. Parse includes reading the input; with several threads, times are summed over
+// threads.
+class ExchangeStats {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	enum Phase {
+		Load,
+		Parse,
+		Lookup,
+		Output,
+		PhaseCount
+	};
+
+private:
+	static const size_t StatusCount = static_cast<size_t>(BitcoinExchange::LineStatus::InvalidRange) + 1;
+
+	Clock::duration _phases[PhaseCount] = {};
+	Clock::duration _samples[PhaseCount] = {};
+	Clock::duration _total = {};
+	uint64_t _lines = 0;
+	uint64_t _ranges = 0;
+	uint64_t _statuses[StatusCount] = {};
+	uint64_t _fallbackDays[STATS_FALLBACK_BUCKETS] = {};
+	uint64_t _rateRows = 0;
+
+public:
+	// Adds the time since start to phase and returns the current time, to chain phases with one clock read
+	Clock::time_point lap(const Phase phase, const Clock::time_point start) {
+		const Clock::time_point now = Clock::now();
+		_phases[phase] += now - start;
+		return now;
+	}
+
+	// lap() for a sampled line, which only counts towards the proportions used by addSampled()
+	Clock::time_point lapSample(const Phase phase, const Clock::time_point start) {
+		const Clock::time_point now = Clock::now();
+		_samples[phase] += now - start;
+		return now;
+	}
+
+	// Splits elapsed over the phases in the proportions of the samples taken since the last call
+	void addSampled(Clock::duration elapsed);
+
+	void addTotal(const Clock::duration duration) { _total += duration; }
+
+	void setRateRows(const uint64_t rows) { _rateRows = rows; }
+
+	// Counts one resolved line; index is only read when status is Ok
+	void countLine(BitcoinExchange::LineStatus status, int key, const RateTable &exchangeRates, size_t index);
+
+	// Counts one range query line
+	void countRange(BitcoinExchange::LineStatus status);
+
+	void merge(const ExchangeStats &other);
+
+	void writeJson(std::ostream &out) const;
+};
@@ -0,0 +1,148 @@
+#include "FixedPoint.hpp"
+
+#include <charconv>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FIXED_POINT_X86 1
+#endif
+
+bool FixedPoint::toUnits(const double number, const uint32_t scale, uint32_t &units) {
+	// -0 has no unsigned units: leave it to the double formatting, which keeps its sign
+	if (!(number >= 0) || std::signbit(number) || number * scale > static_cast<double>(UINT32_MAX)) {
+		return false;
+	}
+	units = static_cast<uint32_t>(std::llround(number * scale));
+	// Division of two exact doubles rounds correctly, like parsing the decimal text units / scale does
+	return static_cast<double>(units) / scale == number;
+}
+
+static void multiplyScalar(const uint32_t *values, const uint32_t *indices, const uint32_t *rates,
+                           uint64_t *products, const size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		products[i] = FixedPoint::multiply(values[i], rates[indices[i]]);
+	}
+}
+
+#ifdef FIXED_POINT_X86
+// _mm_mul_epu32 multiplies the low 32 bits of each 64-bit lane into a full 64-bit product
+__attribute__((target("sse2")))
+static void multiplySse2(const uint32_t *values, const uint32_t *indices, const uint32_t *rates,
+                         uint64_t *products, const size_t count) {
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		const __m128i value = _mm_set_epi64x(values[i + 1], values[i]);
+		const __m128i rate = _mm_set_epi64x(rates[indices[i + 1]], rates[indices[i]]);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(products + i), _mm_mul_epu32(value, rate));
+	}
+	multiplyScalar(values + i, indices + i, rates, products + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void multiplyAvx2(const uint32_t *values, const uint32_t *indices, const uint32_t *rates,
+                         uint64_t *products, const size_t count) {
+	const int *rateBase = reinterpret_cast<const int *>(rates);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indices + i));
+		const __m256i rate = _mm256_i32gather_epi32(rateBase, index, 4);
+		const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+
+		const __m256i low = _mm256_mul_epu32(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(value)),
+		                                     _mm256_cvtepu32_epi64(_mm256_castsi256_si128(rate)));
+		const __m256i high = _mm256_mul_epu32(_mm256_cvtepu32_epi64(_mm256_extracti128_si256(value, 1)),
+		                                      _mm256_cvtepu32_epi64(_mm256_extracti128_si256(rate, 1)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(products + i), low);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(products + i + 4), high);
+	}
+	multiplyScalar(values + i, indices + i, rates, products + i, count - i);
+}
+#endif
+
+bool FixedPoint::isSupported(const Kernel kernel) {
+	switch (kernel) {
+#ifdef FIXED_POINT_X86
+		case Kernel::Avx2:
+			return __builtin_cpu_supports("avx2");
+		case Kernel::Sse2:
+			return __builtin_cpu_supports("sse2");
+#else
+		case Kernel::Avx2:
+		case Kernel::Sse2:
+			return false;
+#endif
+		case Kernel::Scalar:
+			break;
+	}
+	return true;
+}
+
+FixedPoint::Kernel FixedPoint::bestKernel() {
+	static const Kernel best = isSupported(Kernel::Avx2) ? Kernel::Avx2
+		: isSupported(Kernel::Sse2) ? Kernel::Sse2 : Kernel::Scalar;
+	return best;
+}
+
+const char *FixedPoint::kernelName(const Kernel kernel) {
+	switch (kernel) {
+		case Kernel::Avx2:
+			return "avx2";
+		case Kernel::Sse2:
+			return "sse2";
+		case Kernel::Scalar:
+			break;
+	}
+	return "scalar";
+}
+
+void FixedPoint::multiplyGathered(const uint32_t *values, const uint32_t *indices, const uint32_t *rates,
+                                  uint64_t *products, const size_t count) {
+	multiplyGathered(bestKernel(), values, indices, rates, products, count);
+}
+
+void FixedPoint::multiplyGathered(const Kernel kernel, const uint32_t *values, const uint32_t *indices,
+                                  const uint32_t *rates, uint64_t *products, const size_t count) {
+	switch (kernel) {
+#ifdef FIXED_POINT_X86
+		case Kernel::Avx2:
+			multiplyAvx2(values, indices, rates, products, count);
+			return;
+		case Kernel::Sse2:
+			multiplySse2(values, indices, rates, products, count);
+			return;
+#else
+		case Kernel::Avx2:
+		case Kernel::Sse2:
+#endif
+		case Kernel::Scalar:
+			break;
+	}
+	multiplyScalar(values, indices, rates, products, count);
+}
+
+void FixedPoint::appendUnits(std::string &text, const uint64_t units, const unsigned decimals) {
+	uint64_t scale = 1;
+	for (unsigned i = 0; i < decimals; ++i) {
+		scale *= 10;
+	}
+	char buffer[24];
+	text.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), units / scale).ptr);
+
+	uint64_t fraction = units % scale;
+	if (fraction == 0) {
+		return;
+	}
+	unsigned places = decimals;
+	while (fraction % 10 == 0) {
+		fraction /= 10;
+		--places;
+	}
+	const size_t start = text.size();
+	text += '.';
+	text.append(places, '0');
+	for (size_t i = text.size() - 1; i > start; --i) {
+		text[i] = static_cast<char>('0' + fraction % 10);
+		fraction /= 10;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Decimal places kept by the fixed-point representation. Values are at most 1000 and rates must fit in 32
+// bits once scaled, so a product always fits in 64 bits.
+#define FIXED_VALUE_DECIMALS 3
+#define FIXED_RATE_DECIMALS 4
+#define FIXED_VALUE_SCALE 1000
+#define FIXED_RATE_SCALE 10000
+
+// Exact decimal arithmetic for valuations: a value or rate is held as an unsigned count of its smallest
+// unit, and a valuation is the exact product of the two, with FIXED_VALUE_DECIMALS + FIXED_RATE_DECIMALS
+// decimal places
+class FixedPoint {
+public:
+	enum class Kernel {
+		Scalar,
+		Sse2,
+		Avx2
+	};
+
+	FixedPoint() = delete;
+
+	~FixedPoint() = delete;
+
+	FixedPoint(const FixedPoint &other) = delete;
+
+	FixedPoint &operator=(const FixedPoint &other) = delete;
+
+	// Units of number at scale, if number is a non-negative decimal with no more places than scale allows
+	// and the units fit in 32 bits. number stands for the decimal text it was parsed from: that text is
+	// recovered as the only decimal with so few places that parses to the same double.
+	static bool toUnits(double number, uint32_t scale, uint32_t &units);
+
+	static uint64_t multiply(const uint32_t value, const uint32_t rate) { return uint64_t(value) * rate; }
+
+	// products[i] = values[i] * rates[indices[i]], with the fastest kernel the CPU supports
+	static void multiplyGathered(const uint32_t *values, const uint32_t *indices, const uint32_t *rates,
+	                             uint64_t *products, size_t count);
+
+	// The same with a given kernel, which must be supported
+	static void multiplyGathered(Kernel kernel, const uint32_t *values, const uint32_t *indices,
+	                             const uint32_t *rates, uint64_t *products, size_t count);
+
+	// Fastest kernel supported by the CPU, chosen once
+	static Kernel bestKernel();
+
+	static bool isSupported(Kernel kernel);
+
+	static const char *kernelName(Kernel kernel);
+
+	// Appends units with the given number of decimal places, without trailing zeros or exponent
+	static void appendUnits(std::string &text, uint64_t units, unsigned decimals);
+};
@@ -0,0 +1,143 @@
+#include "LineReader.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+LineReader::LineReader(const std::string &path) {
+	if (path == "-") {
+		_fd = STDIN_FILENO;
+		_ownsFd = false;
+	} else {
+		_fd = open(path.c_str(), O_RDONLY);
+		if (_fd == -1) return;
+	}
+	mapOrBuffer();
+}
+
+LineReader::LineReader(const int fd) : _fd(fd), _ownsFd(false) {
+	mapOrBuffer();
+}
+
+void LineReader::mapOrBuffer() {
+	struct stat st = {};
+	if (fstat(_fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		void *data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, _fd, 0);
+		if (data != MAP_FAILED) {
+			madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+			_mapped = static_cast<const char *>(data);
+			_mappedSize = static_cast<size_t>(st.st_size);
+			return;
+		}
+	}
+
+	// Not mappable: fall back to buffered reads
+	_buffer.resize(LINE_READER_CHUNK_SIZE);
+}
+
+LineReader::~LineReader() {
+	if (_mapped) {
+		munmap(const_cast<char *>(_mapped), _mappedSize);
+	}
+	if (_ownsFd && _fd != -1) {
+		close(_fd);
+	}
+}
+
+void LineReader::fill() {
+	if (_begin > 0) {
+		std::memmove(_buffer.data(), _buffer.data() + _begin, _end - _begin);
+		_end -= _begin;
+		_begin = 0;
+	}
+	if (_end == _buffer.size()) {
+		_buffer.resize(_buffer.size() * 2); // a single line longer than the buffer
+	}
+
+	ssize_t n;
+	do {
+		n = read(_fd, _buffer.data() + _end, _buffer.size() - _end);
+	} while (n == -1 && errno == EINTR);
+
+	if (n <= 0) {
+		_eof = true;
+	} else {
+		_end += static_cast<size_t>(n);
+	}
+}
+
+bool LineReader::isEmpty() {
+	if (_mapped) return false;
+	while (_begin == _end && !_eof) {
+		fill();
+	}
+	return _begin == _end;
+}
+
+bool LineReader::nextLine(std::string_view &line) {
+	if (_mapped) {
+		if (_mappedPos == _mappedSize) return false;
+		const char *start = _mapped + _mappedPos;
+		const size_t remaining = _mappedSize - _mappedPos;
+		const auto *newline = static_cast<const char *>(std::memchr(start, '\n', remaining));
+		const size_t length = newline ? static_cast<size_t>(newline - start) : remaining;
+		line = std::string_view(start, length);
+		_mappedPos += newline ? length + 1 : length;
+		return true;
+	}
+
+	if (_buffer.empty()) return false;
+
+	size_t scanned = _begin;
+	for (;;) {
+		const char *start = _buffer.data() + _begin;
+		const auto *newline = static_cast<const char *>(std::memchr(_buffer.data() + scanned, '\n', _end - scanned));
+		if (newline) {
+			line = std::string_view(start, static_cast<size_t>(newline - start));
+			_begin = static_cast<size_t>(newline - _buffer.data()) + 1;
+			_offset += line.size() + 1;
+			return true;
+		}
+		if (_eof) {
+			if (_begin == _end) return false;
+			line = std::string_view(start, _end - _begin);
+			_begin = _end;
+			_offset += line.size();
+			return true;
+		}
+		scanned = _end - _begin; // fill() moves the pending bytes to the front
+		fill();
+	}
+}
+
+bool LineReader::hasBufferedLine() const {
+	if (_mapped) return _mappedPos < _mappedSize;
+	return _begin < _end && std::memchr(_buffer.data() + _begin, '\n', _end - _begin) != nullptr;
+}
+
+bool LineReader::nextChunk(const size_t targetSize, std::string_view &chunk, std::string &storage) {
+	if (_mapped) {
+		if (_mappedPos == _mappedSize) return false;
+		size_t end = std::min(_mappedPos + targetSize, _mappedSize);
+		if (end < _mappedSize) {
+			const auto *newline = static_cast<const char *>(std::memchr(_mapped + end, '\n', _mappedSize - end));
+			end = newline ? static_cast<size_t>(newline - _mapped) + 1 : _mappedSize;
+		}
+		chunk = std::string_view(_mapped + _mappedPos, end - _mappedPos);
+		_mappedPos = end;
+		return true;
+	}
+
+	storage.clear();
+	std::string_view line;
+	while (storage.size() < targetSize && nextLine(line)) {
+		storage.append(line);
+		storage.push_back('\n');
+	}
+	chunk = storage;
+	return !storage.empty();
+}
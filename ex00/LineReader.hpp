@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define LINE_READER_CHUNK_SIZE (64 * 1024)
+
+// Splits a file into lines without copying them. Regular files are memory-mapped; pipes, terminals
+// and stdin (path "-") are read in chunks into a buffer that is reused for the whole file.
+class LineReader {
+	int _fd = -1;
+	bool _ownsFd = true;
+
+	const char *_mapped = nullptr;
+	size_t _mappedSize = 0;
+	size_t _mappedPos = 0;
+
+	std::vector<char> _buffer;
+	size_t _begin = 0;
+	size_t _end = 0;
+	bool _eof = false;
+	uint64_t _offset = 0; // bytes handed out so far, in buffered mode
+
+	void fill();
+
+	void mapOrBuffer();
+
+public:
+	explicit LineReader(const std::string &path);
+
+	// Reads from an already open descriptor, such as a socket, without taking ownership of it
+	explicit LineReader(int fd);
+
+	~LineReader();
+
+	LineReader(const LineReader &other) = delete;
+
+	LineReader &operator=(const LineReader &other) = delete;
+
+	[[nodiscard]] bool isOpen() const { return _fd != -1; }
+
+	// True if the file holds no bytes at all
+	[[nodiscard]] bool isEmpty();
+
+	// The returned view stays valid until the next call, and does not include the '\n'
+	bool nextLine(std::string_view &line);
+
+	// Position in the file just past the last line returned
+	[[nodiscard]] uint64_t offset() const { return _mapped ? _mappedPos : _offset; }
+
+	// True if nextLine() can return a complete line without waiting for more input
+	[[nodiscard]] bool hasBufferedLine() const;
+
+	// Returns about targetSize bytes of whole lines. Mapped files are viewed in place; otherwise the
+	// lines are copied into storage, which must outlive the view.
+	bool nextChunk(size_t targetSize, std::string_view &chunk, std::string &storage);
+};
@@ -0,0 +1,62 @@
+#include "OutputStage.hpp"
+
+#include <cerrno>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const int streamFds[] = { STDOUT_FILENO, STDERR_FILENO };
+
+OutputStage::OutputStage(FlushPolicy policy, const size_t capacity) : _policy(policy), _capacity(capacity) {
+	if (_policy == FlushPolicy::Auto) {
+		_policy = isatty(STDOUT_FILENO) ? FlushPolicy::Line : FlushPolicy::Block;
+	}
+
+	struct stat out = {};
+	struct stat err = {};
+	_sameTarget = fstat(STDOUT_FILENO, &out) == 0 && fstat(STDERR_FILENO, &err) == 0
+	              && out.st_dev == err.st_dev && out.st_ino == err.st_ino;
+
+	for (std::string &buffer: _buffers) {
+		buffer.reserve(_capacity + 256);
+	}
+}
+
+OutputStage::~OutputStage() {
+	flush();
+}
+
+void OutputStage::flush(const Stream stream) {
+	std::string &buffer = _buffers[stream];
+	size_t written = 0;
+	while (written < buffer.size()) {
+		const ssize_t n = ::write(streamFds[stream], buffer.data() + written, buffer.size() - written);
+		if (n == -1 && errno == EINTR) continue;
+		if (n <= 0) break; // like std::cout, a broken stream is not reported
+		written += static_cast<size_t>(n);
+	}
+	buffer.clear();
+}
+
+void OutputStage::flush() {
+	flush(Out);
+	flush(Err);
+}
+
+std::string &OutputStage::buffer(const Stream stream) {
+	const Stream other = stream == Out ? Err : Out;
+	if (_sameTarget && !_buffers[other].empty()) {
+		flush(other);
+	}
+	return _buffers[stream];
+}
+
+void OutputStage::commit(const Stream stream) {
+	if (_policy == FlushPolicy::Line || _buffers[stream].size() >= _capacity) {
+		flush(stream);
+	}
+}
+
+void OutputStage::write(const Stream stream, const std::string_view text) {
+	buffer(stream).append(text);
+	commit(stream);
+}
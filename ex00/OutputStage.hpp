@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#define OUTPUT_BUFFER_SIZE (256 * 1024)
+
+enum class FlushPolicy {
+	Auto, // Line when stdout is a terminal, Block otherwise
+	Line, // write every line as soon as it is complete
+	Block // write when a buffer fills up, and at the end
+};
+
+// Buffers stdout and stderr lines and writes them with as few system calls as the flush policy allows.
+// When both streams lead to the same file, switching streams flushes the other one first, so lines stay
+// in their original order.
+class OutputStage {
+public:
+	enum Stream {
+		Out,
+		Err
+	};
+
+private:
+	std::string _buffers[2];
+	FlushPolicy _policy;
+	size_t _capacity;
+	bool _sameTarget;
+
+	void flush(Stream stream);
+
+public:
+	explicit OutputStage(FlushPolicy policy, size_t capacity = OUTPUT_BUFFER_SIZE);
+
+	~OutputStage();
+
+	OutputStage(const OutputStage &other) = delete;
+
+	OutputStage &operator=(const OutputStage &other) = delete;
+
+	// Buffer to append the next line of stream to; call commit() once the line is complete
+	std::string &buffer(Stream stream);
+
+	void commit(Stream stream);
+
+	void write(Stream stream, std::string_view text);
+
+	void flush();
+};
@@ -0,0 +1,136 @@
+#include "RateSnapshot.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+static size_t alignTo8(const size_t n) {
+	return (n + 7) & ~static_cast<size_t>(7);
+}
+
+// FNV-1a over 64-bit words of the three arrays; each is zero-padded to 8 bytes
+uint64_t RateSnapshot::checksum(const RateSnapshotHeader &header, const char *base) {
+	uint64_t hash = 14695981039346656037ull;
+	const auto mix = [&hash](const char *data, const size_t size) {
+		for (size_t i = 0; i < size; i += 8) {
+			uint64_t word;
+			std::memcpy(&word, data + i, 8);
+			hash = (hash ^ word) * 1099511628211ull;
+		}
+	};
+	mix(base + header.datesOffset, alignTo8(header.count * sizeof(int)));
+	mix(base + header.ratesOffset, header.count * sizeof(double));
+	mix(base + header.denseOffset, alignTo8(header.denseDays * sizeof(uint32_t)));
+	return hash;
+}
+
+int64_t RateSnapshot::mtimeNs(const struct stat &source) {
+	return static_cast<int64_t>(source.st_mtim.tv_sec) * 1000000000 + source.st_mtim.tv_nsec;
+}
+
+bool RateSnapshot::load(const std::string &path, const struct stat &source, RateTable &table) {
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd == -1) return false;
+
+	struct stat st = {};
+	if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(RateSnapshotHeader)) {
+		close(fd);
+		return false;
+	}
+
+	const size_t size = static_cast<size_t>(st.st_size);
+	void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) return false;
+	std::shared_ptr<const void> mapping(data, [size](const void *p) {
+		munmap(const_cast<void *>(p), size);
+	});
+
+	const char *base = static_cast<const char *>(data);
+	RateSnapshotHeader header;
+	std::memcpy(&header, base, sizeof(header));
+
+	if (std::memcmp(header.magic, RATE_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+	    || header.version != RATE_SNAPSHOT_VERSION || header.headerSize != sizeof(RateSnapshotHeader)
+	    || header.sourceMtimeNs != mtimeNs(source) || header.sourceSize != static_cast<uint64_t>(source.st_size)) {
+		return false;
+	}
+
+	// Bound the counts by the file size before multiplying them, so that no crafted count can wrap around
+	if (header.datesOffset != alignTo8(header.headerSize) || header.datesOffset > size
+	    || header.count > (size - header.datesOffset) / (sizeof(int) + sizeof(double))) {
+		return false;
+	}
+	const uint64_t denseOffset = header.datesOffset + alignTo8(header.count * sizeof(int))
+	                             + header.count * sizeof(double);
+	if (header.ratesOffset != header.datesOffset + alignTo8(header.count * sizeof(int))
+	    || header.denseOffset != denseOffset || denseOffset > size
+	    || header.denseDays > (size - denseOffset) / sizeof(uint32_t)
+	    || denseOffset + alignTo8(header.denseDays * sizeof(uint32_t)) != size
+	    || checksum(header, base) != header.checksum) {
+		return false;
+	}
+
+	const int *dates = reinterpret_cast<const int *>(base + header.datesOffset);
+	const uint32_t *denseIndex = reinterpret_cast<const uint32_t *>(base + header.denseOffset);
+	if (header.denseDays > 0) {
+		// Every lookup trusts these rows, so check them once here
+		if (header.count == 0 || header.firstDay != RateTable::daysFromDate(dates[0])) return false;
+		for (size_t day = 0; day < header.denseDays; ++day) {
+			if (denseIndex[day] >= header.count) return false;
+		}
+	}
+
+	table.borrow(dates, reinterpret_cast<const double *>(base + header.ratesOffset), header.count,
+	             std::move(mapping));
+	if (header.denseDays > 0) {
+		table.borrowDenseIndex(denseIndex, header.denseDays, static_cast<int>(header.firstDay));
+	}
+	return true;
+}
+
+bool RateSnapshot::write(const std::string &path, const struct stat &source, const RateTable &table) {
+	RateSnapshotHeader header = {};
+	std::memcpy(header.magic, RATE_SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = RATE_SNAPSHOT_VERSION;
+	header.headerSize = sizeof(RateSnapshotHeader);
+	header.count = table.size();
+	header.datesOffset = alignTo8(header.headerSize);
+	header.ratesOffset = header.datesOffset + alignTo8(header.count * sizeof(int));
+	header.denseOffset = header.ratesOffset + header.count * sizeof(double);
+	header.denseDays = table.denseDays();
+	header.firstDay = table.firstDay();
+	header.sourceMtimeNs = mtimeNs(source);
+	header.sourceSize = static_cast<uint64_t>(source.st_size);
+
+	std::vector<char> image(header.denseOffset + alignTo8(header.denseDays * sizeof(uint32_t)), 0);
+	if (header.count > 0) {
+		std::memcpy(image.data() + header.datesOffset, table.dates(), header.count * sizeof(int));
+		std::memcpy(image.data() + header.ratesOffset, table.rates(), header.count * sizeof(double));
+	}
+	if (header.denseDays > 0) {
+		std::memcpy(image.data() + header.denseOffset, table.denseIndex(), header.denseDays * sizeof(uint32_t));
+	}
+	header.checksum = checksum(header, image.data());
+	std::memcpy(image.data(), &header, sizeof(header));
+
+	const std::string tmpPath = path + ".tmp." + std::to_string(getpid());
+	const int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) return false;
+
+	size_t written = 0;
+	while (written < image.size()) {
+		const ssize_t n = ::write(fd, image.data() + written, image.size() - written);
+		if (n <= 0) break;
+		written += static_cast<size_t>(n);
+	}
+
+	if (close(fd) != 0 || written != image.size() || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+		unlink(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <sys/stat.h>
+
+#include "RateTable.hpp"
+
+#define RATE_SNAPSHOT_MAGIC "BTCRATES"
+#define RATE_SNAPSHOT_VERSION 2
+
+// On-disk layout, in native byte order: this header, the sorted date array at datesOffset, the rate
+// array at ratesOffset and the day-indexed table at denseOffset, empty when the dates are too sparse
+// for one. The source fields identify the CSV file the snapshot was built from.
+struct RateSnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	uint64_t count;
+	uint64_t datesOffset;
+	uint64_t ratesOffset;
+	uint64_t denseOffset;
+	uint64_t denseDays;
+	int64_t firstDay;
+	int64_t sourceMtimeNs;
+	uint64_t sourceSize;
+	uint64_t checksum;
+};
+
+class RateSnapshot {
+	static uint64_t checksum(const RateSnapshotHeader &header, const char *base);
+
+	static int64_t mtimeNs(const struct stat &source);
+
+public:
+	RateSnapshot() = delete;
+
+	~RateSnapshot() = delete;
+
+	RateSnapshot(const RateSnapshot &other) = delete;
+
+	RateSnapshot &operator=(const RateSnapshot &other) = delete;
+
+	// Maps the snapshot into table, day-indexed table included, if it is intact and was built from a file
+	// matching source
+	static bool load(const std::string &path, const struct stat &source, RateTable &table);
+
+	// Writes to a temporary file and renames it over path, so readers never see a partial snapshot
+	static bool write(const std::string &path, const struct stat &source, const RateTable &table);
+};
@@ -0,0 +1,342 @@
+#include "RateTable.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+#include "FixedPoint.hpp"
+
+void RateTable::borrow(const int *dates, const double *rates, const size_t size,
+                       std::shared_ptr<const void> mapping) {
+	_ownedDates = {};
+	_ownedRates = {};
+	_mapping = std::move(mapping);
+	_dates = dates;
+	_rates = rates;
+	_size = size;
+	_sorted = true;
+	_seen = {};
+	dropDenseIndex();
+	_fixedRates = {};
+	dropRangeIndex();
+}
+
+void RateTable::useOwnedRows() {
+	_dates = _ownedDates.data();
+	_rates = _ownedRates.data();
+	_size = _ownedDates.size();
+}
+
+RateTable RateTable::clone() const {
+	RateTable copy;
+	copy._ownedDates.assign(_dates, _dates + _size);
+	copy._ownedRates.assign(_rates, _rates + _size);
+	copy.useOwnedRows();
+	return copy;
+}
+
+void RateTable::ownRows() {
+	if (!_mapping) return;
+	// Rows borrowed from a snapshot are read-only, so take a private copy first
+	_ownedDates.assign(_dates, _dates + _size);
+	_ownedRates.assign(_rates, _rates + _size);
+	_mapping.reset();
+}
+
+bool RateTable::append(const int date, const double rate) {
+	ownRows();
+
+	if (_sorted && !_ownedDates.empty() && date <= _ownedDates.back()) {
+		if (date == _ownedDates.back()) {
+			return false;
+		}
+		_sorted = false;
+		_seen.insert(_ownedDates.begin(), _ownedDates.end());
+	}
+
+	if (!_sorted && !_seen.insert(date).second) {
+		return false;
+	}
+
+	_ownedDates.push_back(date);
+	_ownedRates.push_back(rate);
+	useOwnedRows();
+	// Stale once rows change; callers rebuild them after finalize()
+	dropDenseIndex();
+	_fixedRates = {};
+	dropRangeIndex();
+	return true;
+}
+
+void RateTable::removeLast() {
+	ownRows();
+	if (!_sorted) {
+		_seen.erase(_ownedDates.back());
+	}
+	_ownedDates.pop_back();
+	_ownedRates.pop_back();
+	useOwnedRows();
+	dropDenseIndex();
+	_fixedRates = {};
+	dropRangeIndex();
+}
+
+void RateTable::finalize() {
+	if (_sorted) return;
+
+	std::vector<size_t> order(_ownedDates.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [this](const size_t a, const size_t b) {
+		return _ownedDates[a] < _ownedDates[b];
+	});
+
+	std::vector<int> dates(order.size());
+	std::vector<double> rates(order.size());
+	for (size_t i = 0; i < order.size(); ++i) {
+		dates[i] = _ownedDates[order[i]];
+		rates[i] = _ownedRates[order[i]];
+	}
+	_ownedDates = std::move(dates);
+	_ownedRates = std::move(rates);
+	useOwnedRows();
+
+	_sorted = true;
+	_seen = {};
+}
+
+int RateTable::daysFromDate(const int date) {
+	const int month = date / 100 % 100;
+	const int day = date % 100;
+	const int year = date / 10000 - (month <= 2);
+	const int era = (year >= 0 ? year : year - 399) / 400;
+	const int yearOfEra = year - era * 400;
+	const int dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	const int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+	return era * 146097 + dayOfEra - 719468;
+}
+
+void RateTable::buildRangeIndex() const {
+	_prefixUnits.assign(_size + 1, 0);
+	_prefixSums = {};
+	for (size_t i = 0; i < _size; ++i) {
+		uint32_t units;
+		if (!FixedPoint::toUnits(_rates[i], FIXED_RATE_SCALE, units)) {
+			_prefixUnits = {};
+			break;
+		}
+		_prefixUnits[i + 1] = _prefixUnits[i] + units;
+	}
+	if (_prefixUnits.empty()) {
+		_prefixSums.assign(_size + 1, 0);
+		for (size_t i = 0; i < _size; ++i) {
+			_prefixSums[i + 1] = _prefixSums[i] + _rates[i];
+		}
+	}
+
+	const size_t blocks = (_size + RANGE_BLOCK_ROWS - 1) / RANGE_BLOCK_ROWS;
+	_blockMin.assign(blocks, 0);
+	_blockMax.assign(blocks, 0);
+	_levelStart.assign(1, 0);
+	for (size_t block = 0; block < blocks; ++block) {
+		const double *first = _rates + block * RANGE_BLOCK_ROWS;
+		const double *last = _rates + std::min(_size, (block + 1) * RANGE_BLOCK_ROWS);
+		_blockMin[block] = *std::min_element(first, last);
+		_blockMax[block] = *std::max_element(first, last);
+	}
+
+	// Level k + 1 combines two overlapping halves of level k
+	for (size_t width = 1; width * 2 <= blocks; width *= 2) {
+		const size_t previous = _levelStart.back();
+		const size_t count = blocks - width * 2 + 1;
+		_levelStart.push_back(_blockMin.size());
+		for (size_t block = 0; block < count; ++block) {
+			_blockMin.push_back(std::min(_blockMin[previous + block], _blockMin[previous + block + width]));
+			_blockMax.push_back(std::max(_blockMax[previous + block], _blockMax[previous + block + width]));
+		}
+	}
+}
+
+void RateTable::dropRangeIndex() {
+	_prefixUnits = {};
+	_prefixSums = {};
+	_blockMin = {};
+	_blockMax = {};
+	_levelStart = {};
+	_rangeIndexOnce = std::make_unique<std::once_flag>();
+}
+
+void RateTable::aggregate(const size_t first, const size_t last, double &average, double &min, double &max) const {
+	std::call_once(*_rangeIndexOnce, [this] { buildRangeIndex(); });
+	const double rows = static_cast<double>(last - first + 1);
+	if (!_prefixUnits.empty()) {
+		// The sum of the range is exact in int64 (rates are below 2^32 units, so up to 2^31 rows fit). While it
+		// stays below 2^53, as it does for ranges of under 2^21 rows, it converts exactly and one division gives
+		// the nearest double to the true average; past that the conversion rounds once more.
+		average = static_cast<double>(_prefixUnits[last + 1] - _prefixUnits[first]) / (FIXED_RATE_SCALE * rows);
+	} else {
+		average = (_prefixSums[last + 1] - _prefixSums[first]) / rows;
+	}
+	min = _rates[first];
+	max = _rates[first];
+
+	const size_t firstBlock = first / RANGE_BLOCK_ROWS;
+	const size_t lastBlock = last / RANGE_BLOCK_ROWS;
+	if (lastBlock - firstBlock < 2) {
+		for (size_t i = first; i <= last; ++i) {
+			min = std::min(min, _rates[i]);
+			max = std::max(max, _rates[i]);
+		}
+		return;
+	}
+
+	// Partial blocks at both ends, then the whole blocks between them from two overlapping table entries
+	for (size_t i = first; i < (firstBlock + 1) * RANGE_BLOCK_ROWS; ++i) {
+		min = std::min(min, _rates[i]);
+		max = std::max(max, _rates[i]);
+	}
+	for (size_t i = lastBlock * RANGE_BLOCK_ROWS; i <= last; ++i) {
+		min = std::min(min, _rates[i]);
+		max = std::max(max, _rates[i]);
+	}
+	const size_t from = firstBlock + 1;
+	const size_t count = lastBlock - from;
+	size_t level = 0;
+	while (size_t(2) << level <= count) {
+		++level;
+	}
+	const size_t left = _levelStart[level] + from;
+	const size_t right = _levelStart[level] + lastBlock - (size_t(1) << level);
+	min = std::min(min, std::min(_blockMin[left], _blockMin[right]));
+	max = std::max(max, std::max(_blockMax[left], _blockMax[right]));
+}
+
+bool RateTable::buildFixedRates() {
+	_fixedRates.resize(_size);
+	for (size_t i = 0; i < _size; ++i) {
+		if (!FixedPoint::toUnits(_rates[i], FIXED_RATE_SCALE, _fixedRates[i])) {
+			_fixedRates = {};
+			return false;
+		}
+	}
+	return true;
+}
+
+bool RateTable::buildDenseIndex() {
+	dropDenseIndex();
+	if (_size == 0) {
+		return false;
+	}
+
+	_firstDay = daysFromDate(_dates[0]);
+	const size_t span = static_cast<size_t>(daysFromDate(_dates[_size - 1]) - _firstDay) + 1;
+	if (span * sizeof(uint32_t) > DENSE_INDEX_MAX_BYTES || span > _size * DENSE_INDEX_MAX_DAYS_PER_ROW) {
+		return false;
+	}
+
+	// Forward-fill: each day points at the most recent row on or before it
+	_ownedDenseIndex.resize(span);
+	size_t row = 0;
+	for (size_t day = 0; day < span; ++day) {
+		while (row + 1 < _size && static_cast<size_t>(daysFromDate(_dates[row + 1]) - _firstDay) <= day) {
+			++row;
+		}
+		_ownedDenseIndex[day] = static_cast<uint32_t>(row);
+	}
+	_denseIndex = _ownedDenseIndex.data();
+	_denseDays = span;
+	return true;
+}
+
+void RateTable::borrowDenseIndex(const uint32_t *index, const size_t days, const int firstDay) {
+	_ownedDenseIndex = {};
+	_denseIndex = index;
+	_denseDays = days;
+	_firstDay = firstDay;
+}
+
+void RateTable::dropDenseIndex() {
+	_ownedDenseIndex = {};
+	_denseIndex = nullptr;
+	_denseDays = 0;
+}
+
+size_t RateTable::findClosestEarlier(const int date) const {
+	if (_size == 0) {
+		return 0;
+	}
+
+	if (_denseDays != 0) {
+		const int day = daysFromDate(date) - _firstDay;
+		if (day < 0) {
+			return _size;
+		}
+		return static_cast<size_t>(day) < _denseDays ? _denseIndex[day] : _size - 1;
+	}
+
+	// Branch-free binary search: the loop runs log2(n) times whatever the data, and the
+	// compiler turns the select into a conditional move instead of a mispredicted jump
+	const int *base = _dates;
+	size_t n = _size;
+	while (n > 1) {
+		const size_t half = n / 2;
+		base = base[half] <= date ? base + half : base;
+		n -= half;
+	}
+
+	return *base <= date ? static_cast<size_t>(base - _dates) : _size;
+}
+
+// Stable LSD radix sort on the date half of packed queries. Packed yyyymmdd dates fit in 28 bits, so
+// two 14-bit passes are enough.
+void RateTable::radixSortByDate(std::vector<uint64_t> &queries) {
+	constexpr int bits = 14;
+	constexpr size_t buckets = 1 << bits;
+	std::vector<uint64_t> buffer(queries.size());
+	std::vector<size_t> offsets(buckets);
+
+	for (int shift = 32; shift < 32 + 2 * bits; shift += bits) {
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (const uint64_t query: queries) {
+			++offsets[query >> shift & (buckets - 1)];
+		}
+		size_t total = 0;
+		for (size_t &offset: offsets) {
+			const size_t n = offset;
+			offset = total;
+			total += n;
+		}
+		for (const uint64_t query: queries) {
+			buffer[offsets[query >> shift & (buckets - 1)]++] = query;
+		}
+		queries.swap(buffer);
+	}
+}
+
+void RateTable::findClosestEarlierBatch(const int *dates, const size_t count, size_t *indices) const {
+	// Date in the high half, position in the low half: sorting the packed keys sorts by date
+	std::vector<uint64_t> queries(count);
+	bool sorted = true;
+	for (size_t i = 0; i < count; ++i) {
+		queries[i] = static_cast<uint64_t>(static_cast<uint32_t>(dates[i])) << 32 | i;
+		sorted = sorted && (i == 0 || dates[i - 1] <= dates[i]);
+	}
+	if (!sorted) {
+		radixSortByDate(queries);
+	}
+
+	// cursor is the number of rows dated on or before the current query. It only moves forward,
+	// galloping so that a few queries spread over a large table still cost O(log n) each.
+	size_t cursor = 0;
+	for (const uint64_t query: queries) {
+		const int date = static_cast<int>(query >> 32);
+		if (cursor < _size && _dates[cursor] <= date) {
+			size_t step = 1;
+			while (cursor + step < _size && _dates[cursor + step] <= date) {
+				step *= 2;
+			}
+			const int *first = _dates + cursor + step / 2;
+			const int *last = _dates + std::min(cursor + step, _size);
+			cursor = static_cast<size_t>(std::upper_bound(first, last, date) - _dates);
+		}
+		indices[query & 0xffffffff] = cursor == 0 ? _size : cursor - 1;
+	}
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+// Upper bounds for the optional day-indexed lookup table, past which the sorted search is used
+#define DENSE_INDEX_MAX_BYTES (64 * 1024 * 1024)
+#define DENSE_INDEX_MAX_DAYS_PER_ROW 64
+
+// Rows per block of the range index: min/max tables cover whole blocks, partial blocks are scanned
+#define RANGE_BLOCK_ROWS 16
+
+// Read-only once loaded: dates and rates are kept as two parallel sorted arrays, either owned by the
+// table or borrowed from a memory-mapped snapshot
+class RateTable {
+	std::vector<int> _ownedDates;
+	std::vector<double> _ownedRates;
+	std::shared_ptr<const void> _mapping; // keeps borrowed arrays alive
+
+	const int *_dates = nullptr;
+	const double *_rates = nullptr;
+	size_t _size = 0;
+
+	// One entry per calendar day from the first to the last date, holding the row in effect that day;
+	// owned, or borrowed from the snapshot like the rows
+	std::vector<uint32_t> _ownedDenseIndex;
+	const uint32_t *_denseIndex = nullptr;
+	size_t _denseDays = 0;
+	int _firstDay = 0;
+
+	// Range index: _prefixUnits[i] is the exact sum of the first i rates in units of 1 / FIXED_RATE_SCALE,
+	// or _prefixSums[i] the floating-point one if a rate does not fit; _blockMin/_blockMax hold one level
+	// per power of two, level k giving the min/max of 2^k blocks starting at each block, from _levelStart[k].
+	// Built by the first aggregate() call, under _rangeIndexOnce, so runs without range queries skip it.
+	mutable std::vector<int64_t> _prefixUnits;
+	mutable std::vector<double> _prefixSums;
+	mutable std::vector<double> _blockMin;
+	mutable std::vector<double> _blockMax;
+	mutable std::vector<size_t> _levelStart;
+	std::unique_ptr<std::once_flag> _rangeIndexOnce = std::make_unique<std::once_flag>();
+
+	// The rates in units of 1 / FIXED_RATE_SCALE, when every one of them fits
+	std::vector<uint32_t> _fixedRates;
+
+	void useOwnedRows();
+
+	void buildRangeIndex() const;
+
+	void dropRangeIndex();
+
+	void ownRows();
+
+	static void radixSortByDate(std::vector<uint64_t> &queries);
+
+	bool _sorted = true;
+	std::unordered_set<int> _seen; // only used once rows arrive out of order
+
+public:
+	RateTable() = default;
+
+	RateTable(const RateTable &other) = delete;
+
+	RateTable &operator=(const RateTable &other) = delete;
+
+	RateTable(RateTable &&other) = default;
+
+	RateTable &operator=(RateTable &&other) = default;
+
+	// Days since 1970-01-01 for a packed yyyymmdd date
+	static int daysFromDate(int date);
+
+	// Points the table at sorted arrays owned by mapping, without copying them
+	void borrow(const int *dates, const double *rates, size_t size, std::shared_ptr<const void> mapping);
+
+	// Owned copy of the rows, for building a new version of a table that readers still use
+	[[nodiscard]] RateTable clone() const;
+
+	// Returns false if the date is already present
+	bool append(int date, double rate);
+
+	void removeLast();
+
+	// Sorts the rows if they were not appended in order
+	void finalize();
+
+	[[nodiscard]] size_t size() const { return _size; }
+
+	[[nodiscard]] bool empty() const { return _size == 0; }
+
+	[[nodiscard]] const int *dates() const { return _dates; }
+
+	[[nodiscard]] const double *rates() const { return _rates; }
+
+	[[nodiscard]] int dateAt(const size_t index) const { return _dates[index]; }
+
+	[[nodiscard]] double rateAt(const size_t index) const { return _rates[index]; }
+
+	// Builds the day-indexed table unless the date span is too sparse for it; returns whether it was built
+	bool buildDenseIndex();
+
+	// Points the day-indexed table at an array owned by the mapping given to borrow()
+	void borrowDenseIndex(const uint32_t *index, size_t days, int firstDay);
+
+	void dropDenseIndex();
+
+	[[nodiscard]] bool hasDenseIndex() const { return _denseDays != 0; }
+
+	[[nodiscard]] const uint32_t *denseIndex() const { return _denseIndex; }
+
+	[[nodiscard]] size_t denseDays() const { return _denseDays; }
+
+	[[nodiscard]] int firstDay() const { return _firstDay; }
+
+	// Builds the fixed-point copy of the rates; returns false, leaving none, if a rate does not fit
+	bool buildFixedRates();
+
+	[[nodiscard]] bool hasFixedRates() const { return !_fixedRates.empty(); }
+
+	[[nodiscard]] const uint32_t *fixedRates() const { return _fixedRates.data(); }
+
+	// Average, minimum and maximum of the rates of rows first to last, both included, in constant time once
+	// the first call built the range index, in linear time and space. Safe to call from several threads.
+	void aggregate(size_t first, size_t last, double &average, double &min, double &max) const;
+
+	// Index of the last date <= date, or size() if every date is later
+	[[nodiscard]] size_t findClosestEarlier(int date) const;
+
+	// findClosestEarlier for many dates at once: the dates are sorted, remembering their positions, and
+	// resolved in one forward merge over the table. indices receives one result per date, in input order.
+	void findClosestEarlierBatch(const int *dates, size_t count, size_t *indices) const;
+};
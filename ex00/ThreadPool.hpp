@@ -0,0 +1,30 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling tasks from one queue
+class ThreadPool {
+	std::vector<std::thread> _workers;
+	std::queue<std::packaged_task<void()> > _tasks;
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	bool _stopping = false;
+
+	void workerLoop();
+
+public:
+	explicit ThreadPool(unsigned threadCount);
+
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &other) = delete;
+
+	ThreadPool &operator=(const ThreadPool &other) = delete;
+
+	std::future<void> submit(std::function<void()> task);
+};
@@ -0,0 +1,224 @@
+#include "Workload.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#define CLUSTER_COUNT 16
+#define CLUSTER_RUN_LENGTH 256
+#define CLUSTER_SPREAD_DAYS 15
+
+// Proleptic Gregorian date of a day count since 1970-01-01
+static void civilFromDays(int days, int &year, int &month, int &day) {
+	days += 719468;
+	const int era = (days >= 0 ? days : days - 146096) / 146097;
+	const int dayOfEra = days - era * 146097;
+	const int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+	const int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+	const int shiftedMonth = (5 * dayOfYear + 2) / 153;
+	day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+	month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+	year = yearOfEra + era * 400 + (month <= 2);
+}
+
+static int daysFromCivil(int year, const int month, const int day) {
+	year -= month <= 2;
+	const int era = (year >= 0 ? year : year - 399) / 400;
+	const int yearOfEra = year - era * 400;
+	const int dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	const int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+	return era * 146097 + dayOfEra - 719468;
+}
+
+static void appendPadded(std::string &text, const int number, const int width) {
+	char buffer[16];
+	const std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+	text.append(static_cast<size_t>(std::max(0, width - static_cast<int>(result.ptr - buffer))), '0');
+	text.append(buffer, result.ptr);
+}
+
+static void appendDay(std::string &text, const int days) {
+	int year, month, day;
+	civilFromDays(days, year, month, day);
+	appendPadded(text, year, 4);
+	text += '-';
+	appendPadded(text, month, 2);
+	text += '-';
+	appendPadded(text, day, 2);
+}
+
+// Values with zero or two decimals, like the ones people type
+static void appendValue(std::string &text, const double value) {
+	char buffer[32];
+	const double rounded = std::round(value * 100) / 100;
+	const std::to_chars_result result = rounded == std::floor(rounded)
+		? std::to_chars(buffer, buffer + sizeof(buffer), static_cast<long>(rounded))
+		: std::to_chars(buffer, buffer + sizeof(buffer), rounded, std::chars_format::fixed, 2);
+	text.append(buffer, result.ptr);
+}
+
+static std::vector<int> queryDays(const Workload &workload, std::mt19937 &rng) {
+	const int lastDay = workload.firstDay + std::max(workload.spanDays, 1) - 1;
+	std::uniform_int_distribution<int> anyDay(workload.firstDay, lastDay);
+	std::vector<int> days(workload.queries);
+
+	if (workload.order == QueryOrder::Clustered) {
+		int centres[CLUSTER_COUNT];
+		for (int &centre: centres) {
+			centre = anyDay(rng);
+		}
+		std::uniform_int_distribution<int> pickCentre(0, CLUSTER_COUNT - 1);
+		std::normal_distribution<double> spread(0, CLUSTER_SPREAD_DAYS);
+		int centre = centres[0];
+		for (size_t i = 0; i < days.size(); ++i) {
+			if (i % CLUSTER_RUN_LENGTH == 0) {
+				centre = centres[pickCentre(rng)];
+			}
+			const int day = centre + static_cast<int>(std::lround(spread(rng)));
+			days[i] = std::clamp(day, workload.firstDay, lastDay);
+		}
+		return days;
+	}
+
+	for (int &day: days) {
+		day = anyDay(rng);
+	}
+	if (workload.order == QueryOrder::Sorted) {
+		std::sort(days.begin(), days.end());
+	}
+	return days;
+}
+
+void WorkloadGenerator::writeRates(const Workload &workload, std::ostream &out) {
+	std::mt19937 rng(workload.seed);
+	std::normal_distribution<double> step(0.001, 0.03);
+	const size_t span = static_cast<size_t>(std::max(workload.spanDays, 1));
+	const size_t rows = std::min(workload.rows, span);
+
+	std::string text = "date,exchange_rate\n";
+	double rate = 0.08;
+	// Selection sampling: the first day always has a row, the others are picked uniformly
+	size_t needed = rows;
+	for (size_t i = 0; i < span && needed > 0; ++i) {
+		if (i > 0 && std::uniform_int_distribution<size_t>(0, span - i - 1)(rng) >= needed) {
+			continue;
+		}
+		appendDay(text, workload.firstDay + static_cast<int>(i));
+		text += ',';
+		appendValue(text, rate);
+		text += '\n';
+		rate = std::clamp(rate * std::exp(step(rng)), 0.01, 1e6);
+		--needed;
+		if (text.size() >= 1 << 20) {
+			out.write(text.data(), static_cast<std::streamsize>(text.size()));
+			text.clear();
+		}
+	}
+	out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+void WorkloadGenerator::writeQueries(const Workload &workload, std::ostream &out) {
+	std::mt19937 rng(workload.seed + 1);
+	std::uniform_real_distribution<double> unit(0, 1);
+	std::uniform_real_distribution<double> validValue(0, 1000);
+	std::uniform_int_distribution<int> invalidKind(0, 2);
+	const std::vector<int> days = queryDays(workload, rng);
+
+	std::string text = "date | value\n";
+	for (const int day: days) {
+		const double kind = unit(rng);
+		if (kind < workload.invalidRatio) {
+			switch (invalidKind(rng)) {
+				case 0: // no " | " delimiter
+					appendDay(text, day);
+					text += " |";
+					appendValue(text, validValue(rng));
+					break;
+				case 1: // month 13
+					appendPadded(text, 2000 + static_cast<int>(unit(rng) * 20), 4);
+					text += "-13-01 | ";
+					appendValue(text, validValue(rng));
+					break;
+				default:
+					appendDay(text, day);
+					text += " | abc";
+					break;
+			}
+		} else {
+			appendDay(text, day);
+			text += " | ";
+			if (kind < workload.invalidRatio + workload.outOfRangeRatio) {
+				appendValue(text, unit(rng) < 0.5 ? -validValue(rng) - 1 : 1001 + validValue(rng));
+			} else {
+				appendValue(text, validValue(rng));
+			}
+		}
+		text += '\n';
+		if (text.size() >= 1 << 20) {
+			out.write(text.data(), static_cast<std::streamsize>(text.size()));
+			text.clear();
+		}
+	}
+	out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+void WorkloadGenerator::writeFiles(const Workload &workload, const std::string &ratesPath,
+                                   const std::string &inputPath) {
+	std::ofstream rates(ratesPath, std::ios::binary | std::ios::trunc);
+	writeRates(workload, rates);
+	if (!rates.flush()) {
+		throw std::runtime_error("Error: Could not write file " + ratesPath);
+	}
+	std::ofstream input(inputPath, std::ios::binary | std::ios::trunc);
+	writeQueries(workload, input);
+	if (!input.flush()) {
+		throw std::runtime_error("Error: Could not write file " + inputPath);
+	}
+}
+
+bool WorkloadGenerator::parseOrder(const std::string &name, QueryOrder &order) {
+	if (name == "sorted") {
+		order = QueryOrder::Sorted;
+	} else if (name == "random") {
+		order = QueryOrder::Random;
+	} else if (name == "clustered") {
+		order = QueryOrder::Clustered;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+const char *WorkloadGenerator::orderName(const QueryOrder order) {
+	switch (order) {
+		case QueryOrder::Sorted:
+			return "sorted";
+		case QueryOrder::Clustered:
+			return "clustered";
+		case QueryOrder::Random:
+			break;
+	}
+	return "random";
+}
+
+bool WorkloadGenerator::parseDay(const std::string &date, int &day) {
+	int year = 0, month = 0, dayOfMonth = 0;
+	if (date.size() != 10 || date[4] != '-' || date[7] != '-') {
+		return false;
+	}
+	const char *text = date.data();
+	if (std::from_chars(text, text + 4, year).ptr != text + 4
+	    || std::from_chars(text + 5, text + 7, month).ptr != text + 7
+	    || std::from_chars(text + 8, text + 10, dayOfMonth).ptr != text + 10
+	    || month < 1 || month > 12 || dayOfMonth < 1 || dayOfMonth > 31) {
+		return false;
+	}
+	day = daysFromCivil(year, month, dayOfMonth);
+	int checkYear, checkMonth, checkDay;
+	civilFromDays(day, checkYear, checkMonth, checkDay);
+	return checkMonth == month && checkDay == dayOfMonth;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+// Synthetic rates files and queries for btc, shared by btc_gen and btc_bench
+
+enum class QueryOrder {
+	Sorted, // ascending dates, like a time series
+	Random, // uniform over the whole span
+	Clustered // runs of nearby dates around a few random centres
+};
+
+struct Workload {
+	size_t rows = 1600; // rows of the rates file
+	int spanDays = 4800; // days covered by the rates file, at least rows
+	int firstDay = 14246; // days since 1970-01-01 of the first row, 2009-01-02 by default
+	size_t queries = 100000; // lines of the input file, header excluded
+	double invalidRatio = 0; // share of lines with a bad format, date or value
+	double outOfRangeRatio = 0; // share of lines with a value outside [0, 1000]
+	QueryOrder order = QueryOrder::Random;
+	unsigned seed = 42;
+};
+
+class WorkloadGenerator {
+public:
+	WorkloadGenerator() = delete;
+
+	~WorkloadGenerator() = delete;
+
+	WorkloadGenerator(const WorkloadGenerator &other) = delete;
+
+	WorkloadGenerator &operator=(const WorkloadGenerator &other) = delete;
+
+	// Writes a rates file, header included, to out
+	static void writeRates(const Workload &workload, std::ostream &out);
+
+	// Writes an input file, header included, to out
+	static void writeQueries(const Workload &workload, std::ostream &out);
+
+	// Writes both files; throws std::runtime_error when one cannot be written
+	static void writeFiles(const Workload &workload, const std::string &ratesPath, const std::string &inputPath);
+
+	static bool parseOrder(const std::string &name, QueryOrder &order);
+
+	static const char *orderName(QueryOrder order);
+
+	// Days since 1970-01-01 for a YYYY-MM-DD date, false when it is not one
+	static bool parseDay(const std::string &date, int &day);
+};
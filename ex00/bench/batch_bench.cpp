@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../RateTable.hpp"
+
+// Compares one lookup per query against RateTable::findClosestEarlierBatch, sort included
+
+// Packed yyyymmdd for the given number of days after 1000-01-01
+static int dateAfter(const int days) {
+	static const int daysInMonth[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	int year = 1000;
+	int rest = days;
+	for (;;) {
+		const bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+		if (rest < (leap ? 366 : 365)) break;
+		rest -= leap ? 366 : 365;
+		++year;
+	}
+	int month = 0;
+	for (;; ++month) {
+		const bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+		const int length = daysInMonth[month] + (month == 1 && leap);
+		if (rest < length) break;
+		rest -= length;
+	}
+	return year * 10000 + (month + 1) * 100 + rest + 1;
+}
+
+static double elapsedNs(const std::chrono::steady_clock::time_point start, const size_t count) {
+	const auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(count);
+}
+
+static void runCase(const RateTable &table, const std::vector<int> &calendar, const size_t queryCount,
+                    const bool sortedQueries, std::mt19937 &rng) {
+	std::uniform_int_distribution<size_t> pick(0, calendar.size() - 1);
+	std::vector<int> queries(queryCount);
+	for (int &q: queries) {
+		q = calendar[pick(rng)];
+	}
+	if (sortedQueries) {
+		std::sort(queries.begin(), queries.end());
+	}
+
+	std::vector<size_t> perLine(queryCount);
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < queryCount; ++i) {
+		perLine[i] = table.findClosestEarlier(queries[i]);
+	}
+	const double perLineNs = elapsedNs(start, queryCount);
+
+	std::vector<size_t> batch(queryCount);
+	start = std::chrono::steady_clock::now();
+	table.findClosestEarlierBatch(queries.data(), queryCount, batch.data());
+	const double batchNs = elapsedNs(start, queryCount);
+
+	std::cout << std::setw(10) << table.size() << std::setw(10) << queryCount << std::setw(8)
+			<< (sortedQueries ? "sorted" : "random") << std::setw(8) << (table.hasDenseIndex() ? "dense" : "sorted")
+			<< std::setw(14) << perLineNs << std::setw(14) << batchNs << std::setw(10) << perLineNs / batchNs << "x"
+			<< (perLine == batch ? "" : "  MISMATCH") << std::endl;
+}
+
+int main() {
+	std::mt19937 rng(42);
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << std::setw(10) << "rows" << std::setw(10) << "queries" << std::setw(8) << "order" << std::setw(8)
+			<< "lookup" << std::setw(14) << "line ns/q" << std::setw(14) << "batch ns/q" << std::setw(11) << "speedup"
+			<< std::endl;
+
+	for (const size_t rows: { 5000ul, 1000000ul }) {
+		// Rates on two days out of three, queries on any day of the same span
+		std::vector<int> calendar;
+		RateTable table;
+		for (size_t day = 0; day < rows * 3 / 2; ++day) {
+			calendar.push_back(dateAfter(static_cast<int>(day)));
+			if (day % 3 != 1) {
+				table.append(calendar.back(), static_cast<double>(day % 1000) + 0.25);
+			}
+		}
+		table.finalize();
+
+		for (const bool dense: { false, true }) {
+			if (dense && !table.buildDenseIndex()) continue;
+			for (const size_t queries: { 10000ul, 1000000ul, 10000000ul }) {
+				for (const bool sortedQueries: { false, true }) {
+					runCase(table, calendar, queries, sortedQueries, rng);
+				}
+			}
+		}
+	}
+	return 0;
+}
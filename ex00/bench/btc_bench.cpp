@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../BitcoinExchange.hpp"
+#include "Workload.hpp"
+
+// Runs btc over a matrix of generated workloads and prints one CSV row per workload on stdout.
+// Parse, lookup and output are timed as separate passes over the same input; lines/s and MB/s come
+// from a full printResult run with stdout and stderr sent to /dev/null. Every time is the best of
+// --repeat runs. Usage: btc_bench [--queries N] [--repeat N] [--threads N] [--batch] [--dir DIR]
+// The workloads are written to a new subdirectory of DIR (default /tmp), removed at the end.
+
+typedef BitcoinExchange::LineStatus LineStatus;
+
+namespace {
+	struct Timings {
+		double load = 0;
+		double parse = 0;
+		double lookup = 0;
+		double output = 0;
+		double endToEnd = 0;
+	};
+
+	struct ParsedLines {
+		std::vector<LineStatus> status;
+		std::vector<int> keys;
+		std::vector<double> values;
+		std::vector<size_t> indexes;
+	};
+}
+
+static double secondsSince(const std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void parsePass(const std::string &inputPath, ParsedLines &lines) {
+	LineReader input(inputPath);
+	std::string_view line;
+	input.nextLine(line);
+	while (input.nextLine(line)) {
+		int key = 0;
+		double value = 0;
+		lines.status.push_back(BitcoinExchange::parseLine(line, key, value));
+		lines.keys.push_back(key);
+		lines.values.push_back(value);
+	}
+}
+
+static void lookupPass(const RateTable &rates, ParsedLines &lines) {
+	lines.indexes.resize(lines.status.size());
+	for (size_t i = 0; i < lines.status.size(); ++i) {
+		if (lines.status[i] != LineStatus::Ok) {
+			continue;
+		}
+		lines.indexes[i] = rates.findClosestEarlier(lines.keys[i]);
+		if (lines.indexes[i] == rates.size()) {
+			lines.status[i] = LineStatus::RateNotFound;
+		}
+	}
+}
+
+// Formats every line and writes it to sink, with the buffer sizes printResult uses
+static void outputPass(const RateTable &rates, const ParsedLines &lines, const int sink) {
+	std::string buffers[2];
+	for (size_t i = 0; i < lines.status.size(); ++i) {
+		std::string &text = buffers[lines.status[i] != LineStatus::Ok];
+		BitcoinExchange::appendLine(lines.status[i], lines.keys[i], lines.values[i], rates, lines.indexes[i], text);
+		if (text.size() >= OUTPUT_BUFFER_SIZE) {
+			if (::write(sink, text.data(), text.size()) < 0) break;
+			text.clear();
+		}
+	}
+	for (const std::string &text: buffers) {
+		if (!text.empty() && ::write(sink, text.data(), text.size()) < 0) break;
+	}
+}
+
+static double runEndToEnd(const std::string &inputPath, const ExchangeOptions &options, const int sink) {
+	std::cout.flush();
+	std::cerr.flush();
+	const int savedOut = dup(STDOUT_FILENO);
+	const int savedErr = dup(STDERR_FILENO);
+	dup2(sink, STDOUT_FILENO);
+	dup2(sink, STDERR_FILENO);
+	const auto start = std::chrono::steady_clock::now();
+	BitcoinExchange::printResult(inputPath, options);
+	const double seconds = secondsSince(start);
+	std::cerr.flush();
+	dup2(savedOut, STDOUT_FILENO);
+	dup2(savedErr, STDERR_FILENO);
+	close(savedOut);
+	close(savedErr);
+	return seconds;
+}
+
+static Timings measure(const std::string &inputPath, const ExchangeOptions &options, const unsigned repeat,
+                       const int sink) {
+	Timings best;
+	best.load = best.parse = best.lookup = best.output = best.endToEnd = 1e300;
+	ExchangeOptions parseOnly = options;
+	parseOnly.useSnapshot = false;
+
+	for (unsigned run = 0; run < repeat; ++run) {
+		auto start = std::chrono::steady_clock::now();
+		const RateTable rates = BitcoinExchange::loadExchangeRates(parseOnly);
+		best.load = std::min(best.load, secondsSince(start));
+
+		ParsedLines lines;
+		start = std::chrono::steady_clock::now();
+		parsePass(inputPath, lines);
+		best.parse = std::min(best.parse, secondsSince(start));
+
+		start = std::chrono::steady_clock::now();
+		lookupPass(rates, lines);
+		best.lookup = std::min(best.lookup, secondsSince(start));
+
+		start = std::chrono::steady_clock::now();
+		outputPass(rates, lines, sink);
+		best.output = std::min(best.output, secondsSince(start));
+
+		best.endToEnd = std::min(best.endToEnd, runEndToEnd(inputPath, options, sink));
+	}
+	return best;
+}
+
+// Removes what the workloads left in the scratch directory, the current one, and then the directory
+static void removeScratch(const std::string &scratch) {
+	std::remove("data.csv");
+	std::remove("data.csv.snapshot");
+	std::remove("input.txt");
+	if (chdir("..") == 0) {
+		rmdir(scratch.substr(scratch.rfind('/') + 1).c_str());
+	}
+}
+
+static bool parseCount(const char *text, unsigned long &count) {
+	char *end = nullptr;
+	count = std::strtoul(text, &end, 10);
+	return *text != '\0' && *end == '\0';
+}
+
+int main(int argc, char **argv) {
+	unsigned long queries = 1000000;
+	unsigned long repeat = 3;
+	unsigned long threads = 1;
+	ExchangeOptions options;
+	std::string directory;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string option = argv[i];
+		if (option == "--batch") {
+			options.batch = true;
+		} else if (option == "--queries" && i + 1 < argc && parseCount(argv[i + 1], queries)) {
+			++i;
+		} else if (option == "--repeat" && i + 1 < argc && parseCount(argv[i + 1], repeat) && repeat > 0) {
+			++i;
+		} else if (option == "--threads" && i + 1 < argc && parseCount(argv[i + 1], threads)) {
+			++i;
+		} else if (option == "--dir" && i + 1 < argc) {
+			directory = argv[++i];
+		} else {
+			std::cerr << "Usage: " << argv[0] << " [--queries N] [--repeat N] [--threads N] [--batch] [--dir DIR]"
+					<< std::endl;
+			return 1;
+		}
+	}
+	// 0 means one thread per core, as for btc --threads
+	options.threads = threads ? static_cast<unsigned>(threads) : std::max(1u, std::thread::hardware_concurrency());
+
+	// btc reads ./data.csv, so every workload is generated in, and run from, a scratch directory of its own,
+	// created under --dir if given: the files of the directory itself are never touched
+	std::string scratch = (directory.empty() ? "/tmp" : directory) + "/btc_bench.XXXXXX";
+	if (!mkdtemp(scratch.data())) {
+		std::perror(("Error: mkdtemp " + scratch).c_str());
+		return 1;
+	}
+	if (chdir(scratch.c_str()) != 0) {
+		std::perror(("Error: " + scratch).c_str());
+		rmdir(scratch.c_str());
+		return 1;
+	}
+	const int sink = open("/dev/null", O_WRONLY);
+	if (sink < 0) {
+		std::perror("Error: /dev/null");
+		removeScratch(scratch);
+		return 1;
+	}
+
+	const std::string mode = options.batch ? "batch" : options.threads > 1 ? "threads" : "sequential";
+	std::cout << "mode,threads,rows,span_days,queries,order,invalid_ratio,out_of_range_ratio,input_bytes,"
+			"load_s,parse_s,lookup_s,output_s,end_to_end_s,lines_per_s,mb_per_s" << std::endl;
+
+	int status = 0;
+	try {
+		for (const size_t rows: { 1600ul, 100000ul }) {
+			for (const QueryOrder order: { QueryOrder::Sorted, QueryOrder::Random, QueryOrder::Clustered }) {
+				for (const double invalid: { 0.0, 0.1 }) {
+					Workload workload;
+					workload.rows = rows;
+					workload.spanDays = static_cast<int>(rows * 3);
+					workload.queries = queries;
+					workload.invalidRatio = invalid;
+					workload.outOfRangeRatio = 0.05;
+					workload.order = order;
+					WorkloadGenerator::writeFiles(workload, "data.csv", "input.txt");
+
+					struct stat input = {};
+					stat("input.txt", &input);
+					const off_t inputBytes = input.st_size;
+					const Timings timings = measure("input.txt", options, static_cast<unsigned>(repeat), sink);
+					std::cout << mode << ',' << options.threads << ',' << rows << ',' << workload.spanDays << ','
+							<< queries << ',' << WorkloadGenerator::orderName(order) << ',' << invalid << ','
+							<< workload.outOfRangeRatio << ',' << inputBytes << ',' << timings.load << ','
+							<< timings.parse << ',' << timings.lookup << ',' << timings.output << ','
+							<< timings.endToEnd << ',' << static_cast<double>(queries) / timings.endToEnd << ','
+							<< static_cast<double>(inputBytes) / timings.endToEnd / 1e6 << std::endl;
+				}
+			}
+		}
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		status = 1;
+	}
+
+	close(sink);
+	removeScratch(scratch);
+	return status;
+}
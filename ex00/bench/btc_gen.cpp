@@ -0,0 +1,85 @@
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "Workload.hpp"
+
+// Writes a rates file and an input file for btc from a few workload knobs
+
+static void printUsage(const char *program) {
+	std::cerr << "Usage: " << program << " [options]\n"
+			<< "  --rows N            rows of the rates file (default 1600)\n"
+			<< "  --span DAYS         days covered by the rates file (default 4800)\n"
+			<< "  --start YYYY-MM-DD  date of the first row (default 2009-01-02)\n"
+			<< "  --queries N         lines of the input file (default 100000)\n"
+			<< "  --invalid RATIO     share of malformed lines (default 0)\n"
+			<< "  --out-of-range R    share of values outside [0, 1000] (default 0)\n"
+			<< "  --order ORDER       sorted, random or clustered query dates (default random)\n"
+			<< "  --seed N            random seed (default 42)\n"
+			<< "  --rates PATH        rates file to write (default data.csv)\n"
+			<< "  --input PATH        input file to write (default input.txt)" << std::endl;
+}
+
+static bool parseNumber(const std::string &text, double &number) {
+	char *end = nullptr;
+	number = std::strtod(text.c_str(), &end);
+	return !text.empty() && *end == '\0' && number >= 0;
+}
+
+int main(int argc, char **argv) {
+	Workload workload;
+	std::string ratesPath = "data.csv";
+	std::string inputPath = "input.txt";
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string option = argv[i];
+		if (i + 1 >= argc) {
+			printUsage(argv[0]);
+			return 1;
+		}
+		const std::string value = argv[++i];
+		double number = 0;
+		bool valid = true;
+		if (option == "--start") {
+			valid = WorkloadGenerator::parseDay(value, workload.firstDay);
+		} else if (option == "--order") {
+			valid = WorkloadGenerator::parseOrder(value, workload.order);
+		} else if (option == "--rates") {
+			ratesPath = value;
+		} else if (option == "--input") {
+			inputPath = value;
+		} else if (parseNumber(value, number)) {
+			if (option == "--rows") {
+				workload.rows = static_cast<size_t>(number);
+			} else if (option == "--span") {
+				workload.spanDays = static_cast<int>(number);
+			} else if (option == "--queries") {
+				workload.queries = static_cast<size_t>(number);
+			} else if (option == "--invalid") {
+				workload.invalidRatio = number;
+			} else if (option == "--out-of-range") {
+				workload.outOfRangeRatio = number;
+			} else if (option == "--seed") {
+				workload.seed = static_cast<unsigned>(number);
+			} else {
+				valid = false;
+			}
+		} else {
+			valid = false;
+		}
+		if (!valid) {
+			std::cerr << "Error: Invalid value for " << option << ": " << value << std::endl;
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	try {
+		WorkloadGenerator::writeFiles(workload, ratesPath, inputPath);
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
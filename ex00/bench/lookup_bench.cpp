@@ -0,0 +1,73 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "../RateTable.hpp"
+
+// Compares the closest-earlier-date lookup of the old std::map layout against RateTable
+
+#define QUERY_COUNT 2000000
+
+template<typename Lookup>
+static double timeQueries(const std::vector<int> &queries, double &checksum, Lookup lookup) {
+	// Warm-up pass so that neither layout pays for first-touch page faults
+	for (const int date: queries) {
+		checksum -= lookup(date);
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	for (const int date: queries) {
+		checksum += lookup(date);
+	}
+	const auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(queries.size());
+}
+
+static void runSize(const size_t rows, std::mt19937 &rng) {
+	std::map<int, double> map;
+	RateTable table;
+
+	// Every third key is present so that most queries need the closest earlier date
+	for (size_t i = 0; i < rows; ++i) {
+		const int date = static_cast<int>(i * 3);
+		const double rate = static_cast<double>(i % 1000) + 0.5;
+		map.emplace(date, rate);
+		table.append(date, rate);
+	}
+	table.finalize();
+
+	std::uniform_int_distribution<int> dist(0, static_cast<int>(rows * 3));
+	std::vector<int> queries(QUERY_COUNT);
+	for (int &q: queries) {
+		q = dist(rng);
+	}
+
+	double mapChecksum = 0;
+	const double mapNs = timeQueries(queries, mapChecksum, [&map](const int date) {
+		auto it = map.upper_bound(date);
+		return it == map.begin() ? 0.0 : (--it)->second;
+	});
+
+	double tableChecksum = 0;
+	const double tableNs = timeQueries(queries, tableChecksum, [&table](const int date) {
+		const size_t index = table.findClosestEarlier(date);
+		return index == table.size() ? 0.0 : table.rateAt(index);
+	});
+
+	std::cout << std::setw(10) << rows << std::setw(14) << mapNs << std::setw(14) << tableNs
+			<< std::setw(10) << mapNs / tableNs << "x" << (mapChecksum == tableChecksum ? "" : "  MISMATCH") << std::endl;
+}
+
+int main() {
+	std::mt19937 rng(42);
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << std::setw(10) << "rows" << std::setw(14) << "map ns/q" << std::setw(14) << "flat ns/q"
+			<< std::setw(11) << "speedup" << std::endl;
+	for (const size_t rows: { 10000ul, 1000000ul, 10000000ul }) {
+		runSize(rows, rng);
+	}
+	return 0;
+}
@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../FixedPoint.hpp"
+
+// Times each fixed-point valuation kernel the CPU supports and checks it against the scalar one
+
+int main() {
+	const size_t rateCount = 5000;
+	const size_t queryCount = 10000000;
+	std::mt19937 rng(42);
+
+	std::vector<uint32_t> rates(rateCount);
+	std::uniform_int_distribution<uint32_t> anyRate(0, 100000 * FIXED_RATE_SCALE);
+	for (uint32_t &rate: rates) {
+		rate = anyRate(rng);
+	}
+	std::vector<uint32_t> values(queryCount);
+	std::vector<uint32_t> indices(queryCount);
+	std::uniform_int_distribution<uint32_t> anyValue(0, 1000 * FIXED_VALUE_SCALE);
+	std::uniform_int_distribution<uint32_t> anyIndex(0, rateCount - 1);
+	for (size_t i = 0; i < queryCount; ++i) {
+		values[i] = anyValue(rng);
+		indices[i] = anyIndex(rng);
+	}
+
+	std::vector<uint64_t> expected(queryCount);
+	FixedPoint::multiplyGathered(FixedPoint::Kernel::Scalar, values.data(), indices.data(), rates.data(),
+	                             expected.data(), queryCount);
+
+	std::cout << std::fixed << std::setprecision(3) << std::setw(8) << "kernel" << std::setw(12) << "ns/query"
+			<< std::endl;
+	for (const FixedPoint::Kernel kernel: { FixedPoint::Kernel::Scalar, FixedPoint::Kernel::Sse2,
+	                                        FixedPoint::Kernel::Avx2 }) {
+		if (!FixedPoint::isSupported(kernel)) {
+			std::cout << std::setw(8) << FixedPoint::kernelName(kernel) << std::setw(12) << "unsupported" << std::endl;
+			continue;
+		}
+		// Best of a few runs over an already touched output array
+		std::vector<uint64_t> products(queryCount);
+		double bestNs = 1e300;
+		for (int run = 0; run < 5; ++run) {
+			const auto start = std::chrono::steady_clock::now();
+			FixedPoint::multiplyGathered(kernel, values.data(), indices.data(), rates.data(), products.data(),
+			                             queryCount);
+			const auto end = std::chrono::steady_clock::now();
+			bestNs = std::min(bestNs, std::chrono::duration<double, std::nano>(end - start).count() / queryCount);
+		}
+		std::cout << std::setw(8) << FixedPoint::kernelName(kernel) << std::setw(12) << bestNs
+				<< (products == expected ? "" : "  MISMATCH")
+				<< (kernel == FixedPoint::bestKernel() ? "  (selected)" : "") << std::endl;
+	}
+	return 0;
+}
@@ -1,14 +1,110 @@
+#include <algorithm>
+#include <charconv>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <thread>
 
 #include "BitcoinExchange.hpp"
+#include "ExchangeStats.hpp"
+#include "FixedPoint.hpp"
+
+static void printUsage(const char *name) {
+	std::cerr << "Usage: " << name << " [options] <filename | ->" << std::endl
+			<< "       " << name << " [options] --serve [--socket PATH]" << std::endl
+			<< "  --sorted-lookup      binary search instead of the day-indexed table" << std::endl
+			<< "  --no-snapshot        always parse " EXCHANGE_RATES_FILE ", never cache it" << std::endl
+			<< "  --threads N          process the input on N threads (0: one per core)" << std::endl
+			<< "  --batch              resolve all queries in one sort-merge pass" << std::endl
+			<< "  --fixed              exact decimal values and products, when every rate fits; a value with more" << std::endl
+			<< "                       than " << FIXED_VALUE_DECIMALS << " decimals is printed as without --fixed" << std::endl
+			<< "  --flush line|block   when output is written (default: line on a terminal)" << std::endl
+			<< "  --stats FILE         write phase times and line counts to FILE as JSON" << std::endl
+			<< "  --serve              answer queries from stdin until EOF, loading the rates once" << std::endl
+			<< "  --socket PATH        with --serve, answer clients of a Unix domain socket instead" << std::endl
+			<< "  --reload-interval MS with --serve, how often to pick up appended rates (0: never)" << std::endl
+			<< "A query \"FROM" RANGE_SEPARATOR "TO | value\" gives the average, minimum and maximum rate over the"
+			" range" << std::endl;
+}
+
+static bool parseUnsigned(const std::string_view str, unsigned &value) {
+	const auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+	return ec == std::errc() && end == str.data() + str.size();
+}
 
 int main(int argc, char *argv[]) {
-	if (argc != 2) {
-		std::cerr << "Usage: " << argv[0] << " <filename>" << std::endl;
+	ExchangeOptions options;
+	std::string fileName;
+	bool serve = false;
+	std::string socketPath;
+	std::string statsPath;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--sorted-lookup") {
+			options.denseLookup = false;
+		} else if (arg == "--no-snapshot") {
+			options.useSnapshot = false;
+		} else if (arg == "--flush" && i + 1 < argc) {
+			const std::string policy = argv[++i];
+			if (policy != "line" && policy != "block") {
+				printUsage(argv[0]);
+				return 1;
+			}
+			options.flushPolicy = policy == "line" ? FlushPolicy::Line : FlushPolicy::Block;
+		} else if (arg == "--serve") {
+			serve = true;
+		} else if (arg == "--socket" && i + 1 < argc) {
+			socketPath = argv[++i];
+		} else if (arg == "--reload-interval" && i + 1 < argc) {
+			if (!parseUnsigned(argv[++i], options.reloadIntervalMs)) {
+				printUsage(argv[0]);
+				return 1;
+			}
+		} else if (arg == "--stats" && i + 1 < argc) {
+			statsPath = argv[++i];
+		} else if (arg == "--batch") {
+			options.batch = true;
+		} else if (arg == "--fixed") {
+			options.fixedPoint = true;
+		} else if (arg == "--threads" && i + 1 < argc) {
+			unsigned threads;
+			if (!parseUnsigned(argv[++i], threads)) {
+				printUsage(argv[0]);
+				return 1;
+			}
+			// 0 means one thread per core
+			options.threads = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+		} else if (arg.rfind("--", 0) == 0 || !fileName.empty()) {
+			printUsage(argv[0]);
+			return 1;
+		} else {
+			fileName = arg;
+		}
+	}
+
+	if (serve ? !fileName.empty() || !statsPath.empty() : fileName.empty() || !socketPath.empty()) {
+		printUsage(argv[0]);
 		return 1;
 	}
 
-	BitcoinExchange::printResult(argv[1]);
+	if (serve) {
+		return BitcoinExchange::serve(socketPath, options);
+	}
+
+	ExchangeStats stats;
+	if (!statsPath.empty()) {
+		options.stats = &stats;
+	}
+	BitcoinExchange::printResult(fileName, options);
+
+	if (!statsPath.empty()) {
+		std::ofstream statsFile(statsPath);
+		stats.writeJson(statsFile);
+		if (!statsFile.flush()) {
+			std::cerr << "Error: Could not write file " << statsPath << std::endl;
+			return 1;
+		}
+	}
 	return 0;
 }
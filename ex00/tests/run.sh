@@ -0,0 +1,20 @@
+#!/bin/sh
+# Usage: tests/run.sh BTC. Each directory under tests/ holds a data.csv, an input.txt and the expected stdout and
+# stderr of "btc --no-snapshot input.txt" run from that directory, in expected.txt. Options listed in an args
+# file are passed too.
+btc=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+cd "$(dirname "$0")" || exit 1
+
+failed=0
+for case in */; do
+	case=${case%/}
+	args=$(cat "$case/args" 2>/dev/null)
+	# shellcheck disable=SC2086 # args holds several options
+	if (cd "$case" && "$btc" --no-snapshot $args input.txt 2>&1 | diff -u expected.txt -); then
+		echo "ok   $case"
+	else
+		echo "FAIL $case"
+		failed=1
+	fi
+done
+exit $failed
@@ -0,0 +1,191 @@
+#include "ColumnEvaluator.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define COLUMN_EVALUATOR_X86 1
+#endif
+
+typedef ColumnEvaluator::Error Error;
+
+// Applies a binary operator lane by lane: a[i] = a[i] op b[i]. A zero divisor flags its row and leaves
+// a[i] meaningless, without stopping the other rows.
+typedef void (*Arithmetic)(RPN::OpCode op, int *a, const int *b, Error *errors, size_t count);
+
+static void flagDivisionByZero(Error &error) {
+	if (error == Error::None)
+		error = Error::DivisionByZero;
+}
+
+// Unsigned arithmetic wraps around like RPN::execute, INT_MIN / -1 included
+static void arithmeticScalar(const RPN::OpCode op, int *a, const int *b, Error *errors, const size_t count) {
+	switch (op)
+	{
+		case RPN::OpCode::Add:
+			for (size_t i = 0; i < count; ++i)
+				a[i] = static_cast<int>(static_cast<unsigned>(a[i]) + static_cast<unsigned>(b[i]));
+			break;
+		case RPN::OpCode::Sub:
+			for (size_t i = 0; i < count; ++i)
+				a[i] = static_cast<int>(static_cast<unsigned>(a[i]) - static_cast<unsigned>(b[i]));
+			break;
+		case RPN::OpCode::Mul:
+			for (size_t i = 0; i < count; ++i)
+				a[i] = static_cast<int>(static_cast<unsigned>(a[i]) * static_cast<unsigned>(b[i]));
+			break;
+		default:
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (b[i] == 0)
+					flagDivisionByZero(errors[i]);
+				else
+					a[i] = b[i] == -1 ? static_cast<int>(0u - static_cast<unsigned>(a[i])) : a[i] / b[i];
+			}
+			break;
+	}
+}
+
+#ifdef COLUMN_EVALUATOR_X86
+// AVX2 has no integer division, but an int quotient computed in double and truncated is exact: the true
+// quotient is never within double rounding of the next integer, and INT_MIN / -1 converts to INT_MIN
+__attribute__((target("avx2")))
+static __m128i divideHalf(const __m128i a, const __m128i b) {
+	return _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_cvtepi32_pd(a), _mm256_cvtepi32_pd(b)));
+}
+
+__attribute__((target("avx2")))
+static void arithmeticAvx2(const RPN::OpCode op, int *a, const int *b, Error *errors, const size_t count) {
+	__m256i *left = reinterpret_cast<__m256i *>(a);
+	const __m256i *right = reinterpret_cast<const __m256i *>(b);
+	const size_t vectors = count / 8;
+	switch (op)
+	{
+		case RPN::OpCode::Add:
+			for (size_t i = 0; i < vectors; ++i)
+				_mm256_storeu_si256(left + i, _mm256_add_epi32(_mm256_loadu_si256(left + i), _mm256_loadu_si256(right + i)));
+			break;
+		case RPN::OpCode::Sub:
+			for (size_t i = 0; i < vectors; ++i)
+				_mm256_storeu_si256(left + i, _mm256_sub_epi32(_mm256_loadu_si256(left + i), _mm256_loadu_si256(right + i)));
+			break;
+		case RPN::OpCode::Mul:
+			for (size_t i = 0; i < vectors; ++i)
+				_mm256_storeu_si256(left + i, _mm256_mullo_epi32(_mm256_loadu_si256(left + i), _mm256_loadu_si256(right + i)));
+			break;
+		default:
+			for (size_t i = 0; i < vectors; ++i)
+			{
+				const __m256i dividend = _mm256_loadu_si256(left + i);
+				__m256i divisor = _mm256_loadu_si256(right + i);
+				const __m256i zero = _mm256_cmpeq_epi32(divisor, _mm256_setzero_si256());
+				if (int lanes = _mm256_movemask_ps(_mm256_castsi256_ps(zero)))
+				{
+					for (Error *error = errors + i * 8; lanes != 0; lanes &= lanes - 1)
+						flagDivisionByZero(error[__builtin_ctz(lanes)]);
+					divisor = _mm256_blendv_epi8(divisor, _mm256_set1_epi32(1), zero);
+				}
+				const __m128i low = divideHalf(_mm256_castsi256_si128(dividend), _mm256_castsi256_si128(divisor));
+				const __m128i high = divideHalf(_mm256_extracti128_si256(dividend, 1),
+				                                _mm256_extracti128_si256(divisor, 1));
+				_mm256_storeu_si256(left + i, _mm256_set_m128i(high, low));
+			}
+			break;
+	}
+	const size_t done = vectors * 8;
+	arithmeticScalar(op, a + done, b + done, errors + done, count - done);
+}
+#endif
+
+ColumnEvaluator::Result ColumnEvaluator::evaluate(const RPN::Program &program, const int *const *columns,
+                                                  const size_t rows) {
+	Result result;
+	result.values.resize(rows);
+	result.errors.resize(rows);
+	evaluate(bestKernel(), program, columns, rows, result.values.data(), result.errors.data());
+	return result;
+}
+
+void ColumnEvaluator::evaluate(const Kernel kernel, const RPN::Program &program, const int *const *columns,
+                               const size_t rows, int *values, Error *errors) {
+	Arithmetic arithmetic = arithmeticScalar;
+#ifdef COLUMN_EVALUATOR_X86
+	if (kernel == Kernel::Avx2)
+		arithmetic = arithmeticAvx2;
+#else
+	(void) kernel;
+#endif
+
+	// Stack level n of the block lives at stack[n * COLUMN_BLOCK_ROWS]
+	std::vector<int> stack(std::max<size_t>(program.maxStack, 1) * COLUMN_BLOCK_ROWS);
+	for (size_t first = 0; first < rows; first += COLUMN_BLOCK_ROWS)
+	{
+		const size_t count = std::min<size_t>(COLUMN_BLOCK_ROWS, rows - first);
+		Error *blockErrors = errors + first;
+		std::fill(blockErrors, blockErrors + count, Error::None);
+
+		size_t top = 0;
+		for (const RPN::Instruction &instruction: program.code)
+		{
+			int *level = stack.data() + top * COLUMN_BLOCK_ROWS;
+			if (instruction.op == RPN::OpCode::Push)
+			{
+				std::fill(level, level + count, instruction.operand);
+				++top;
+			}
+			else if (instruction.op == RPN::OpCode::Load)
+			{
+				const int *column = columns[instruction.operand] + first;
+				std::copy(column, column + count, level);
+				++top;
+			}
+			else if (instruction.op == RPN::OpCode::Trap)
+			{
+				// Every row still running fails here, so the block is done
+				std::replace(blockErrors, blockErrors + count, Error::None, Error::Trap);
+				break;
+			}
+			else
+			{
+				--top;
+				arithmetic(instruction.op, level - 2 * COLUMN_BLOCK_ROWS, level - COLUMN_BLOCK_ROWS, blockErrors, count);
+			}
+		}
+
+		for (size_t i = 0; i < count; ++i)
+			values[first + i] = blockErrors[i] == Error::None ? stack[i] : 0;
+	}
+}
+
+bool ColumnEvaluator::isSupported(const Kernel kernel) {
+#ifdef COLUMN_EVALUATOR_X86
+	if (kernel == Kernel::Avx2)
+		return __builtin_cpu_supports("avx2");
+#else
+	if (kernel == Kernel::Avx2)
+		return false;
+#endif
+	return true;
+}
+
+ColumnEvaluator::Kernel ColumnEvaluator::bestKernel() {
+	static const Kernel best = isSupported(Kernel::Avx2) ? Kernel::Avx2 : Kernel::Scalar;
+	return best;
+}
+
+const char *ColumnEvaluator::kernelName(const Kernel kernel) {
+	return kernel == Kernel::Avx2 ? "avx2" : "scalar";
+}
+
+const char *ColumnEvaluator::errorMessage(const RPN::Program &program, const Error error) {
+	switch (error)
+	{
+		case Error::DivisionByZero:
+			return "Error: division by zero";
+		case Error::Trap:
+			return program.trapMessage.c_str();
+		case Error::None:
+			break;
+	}
+	return "";
+}
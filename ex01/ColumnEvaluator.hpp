@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "RPN.hpp"
+
+// Rows evaluated together: the stack holds Program::maxStack columns of this many ints, small enough to
+// stay in L1/L2 for ordinary expressions
+#define COLUMN_BLOCK_ROWS 1024
+
+// Runs one compiled Program over columns of variable bindings, one instruction at a time over a whole block
+// of rows instead of one row at a time. Every row gets the result or error RPN::execute would give it.
+class ColumnEvaluator {
+public:
+	enum class Kernel {
+		Scalar,
+		Avx2
+	};
+
+	// Why a row has no result; the first error of a row wins, as when executing it on its own
+	enum class Error : unsigned char {
+		None,
+		DivisionByZero,
+		Trap // Program::trapMessage
+	};
+
+	struct Result {
+		std::vector<int> values; // 0 where errors is not None
+		std::vector<Error> errors;
+	};
+
+	ColumnEvaluator() = delete;
+	~ColumnEvaluator() = delete;
+	ColumnEvaluator(const ColumnEvaluator &other) = delete;
+	ColumnEvaluator &operator=(const ColumnEvaluator &other) = delete;
+
+	// columns[slot] holds rows values of the variable in that slot, with the fastest kernel the CPU supports
+	static Result evaluate(const RPN::Program &program, const int *const *columns, size_t rows);
+
+	// The same into caller-owned columns of rows entries, with a given kernel, which must be supported
+	static void evaluate(Kernel kernel, const RPN::Program &program, const int *const *columns, size_t rows,
+	                     int *values, Error *errors);
+
+	// Fastest kernel supported by the CPU, chosen once
+	static Kernel bestKernel();
+
+	static bool isSupported(Kernel kernel);
+
+	static const char *kernelName(Kernel kernel);
+
+	// The message RPN::execute throws for error
+	static const char *errorMessage(const RPN::Program &program, Error error);
+};
@@ -1,63 +1,462 @@
-
 #include "RPN.hpp"
 
-#include <sstream>
-#include <stack>
+#include <algorithm>
+#include <charconv>
+#include <deque>
+#include <future>
+#include <memory>
+#include <stdexcept>
+
+#include "ThreadPool.hpp"
+#include "TokenReader.hpp"
+
+// Same whitespace as operator>> on a std::string
+static bool isSpace(const char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r'); // \t \n \v \f \r
+}
+
+// Moves pos past the next whitespace-separated token; false once only whitespace is left
+static bool nextToken(const std::string_view text, size_t &pos, std::string_view &token) {
+	while (pos < text.size() && isSpace(text[pos]))
+		++pos;
+	if (pos == text.size())
+		return false;
+	const size_t start = pos;
+	while (pos < text.size() && !isSpace(text[pos]))
+		++pos;
+	token = text.substr(start, pos - start);
+	return true;
+}
+
+static bool isOperator(const std::string_view token) {
+	return token.size() == 1 && (token[0] == '+' || token[0] == '-' || token[0] == '*' || token[0] == '/');
+}
+
+// A decimal int, optionally negative, such as 7, 42 or -3
+static bool parseLiteral(const std::string_view token, int &value) {
+	if (token.size() == 1 && token[0] >= '0' && token[0] <= '9')
+	{
+		value = token[0] - '0';
+		return true;
+	}
+	const char *end = token.data() + token.size();
+	const std::from_chars_result result = std::from_chars(token.data(), end, value);
+	return result.ec == std::errc() && result.ptr == end;
+}
+
+static bool isIdentifier(const std::string_view token) {
+	for (size_t i = 0; i < token.size(); ++i)
+	{
+		const char c = token[i];
+		const bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+		if (!letter && (i == 0 || c < '0' || c > '9'))
+			return false;
+	}
+	return !token.empty();
+}
+
+// Arithmetic wraps around like two's complement instead of overflowing, INT_MIN / -1 included
+static int add(const int a, const int b) {
+	return static_cast<int>(static_cast<unsigned>(a) + static_cast<unsigned>(b));
+}
+
+static int subtract(const int a, const int b) {
+	return static_cast<int>(static_cast<unsigned>(a) - static_cast<unsigned>(b));
+}
+
+static int multiply(const int a, const int b) {
+	return static_cast<int>(static_cast<unsigned>(a) * static_cast<unsigned>(b));
+}
+
+static int divide(const int a, const int b) {
+	if (b == 0)
+		throw std::runtime_error("Error: division by zero");
+	return b == -1 ? subtract(0, a) : a / b;
+}
 
 int RPN::evaluate(const std::string &expression) {
-	// We'll use a stack container to evaluate the RPN expression
-	std::stack<int> st;
-	std::istringstream iss(expression);
-	std::string token;
+	const std::string_view text(expression);
+	std::string_view token;
 
-	while (iss >> token)
+	// Pre-scan: the stack never holds more values than there are operands, so it can live on the
+	// stack frame, and only expressions with more than RPN_INLINE_STACK operands allocate
+	size_t operands = 0;
+	for (size_t pos = 0; nextToken(text, pos, token);)
 	{
-		// Check if token is a single-digit number
-		if (token.size() == 1 && (token[0] >= '0' && token[0] <= '9'))
-		{
-			// Push the integer value onto the stack
-			st.push(token[0] - '0');
-		}
-		// Otherwise, check if it is a supported operator
-		else if (token == "+" || token == "-" || token == "*" || token == "/")
+		if (!isOperator(token))
+			++operands;
+	}
+	int inlineStack[RPN_INLINE_STACK];
+	std::vector<int> heapStack;
+	int *stack = inlineStack;
+	if (operands > RPN_INLINE_STACK)
+	{
+		heapStack.resize(operands);
+		stack = heapStack.data();
+	}
+
+	size_t top = 0;
+	for (size_t pos = 0; nextToken(text, pos, token);)
+	{
+		// Check if token is a supported operator
+		if (isOperator(token))
 		{
 			// We need at least two values on the stack
-			if (st.size() < 2)
+			if (top < 2)
 				throw std::runtime_error("Error: not enough operands for operator");
 
-			const int b = st.top(); // second operand
-			st.pop();
-			const int a = st.top(); // first operand
-			st.pop();
+			const int b = stack[--top]; // second operand
+			const int a = stack[top - 1]; // first operand
 
 			int result = 0;
-			if (token == "+")
-				result = a + b;
-			else if (token == "-")
-				result = a - b;
-			else if (token == "*")
-				result = a * b;
-			else if (token == "/")
-			{
-				if (b == 0)
-					throw std::runtime_error("Error: division by zero");
-				result = a / b;
-			}
+			if (token[0] == '+')
+				result = add(a, b);
+			else if (token[0] == '-')
+				result = subtract(a, b);
+			else if (token[0] == '*')
+				result = multiply(a, b);
+			else
+				result = divide(a, b);
 
-			// Push the result back onto the stack
-			st.push(result);
+			// The result replaces the first operand
+			stack[top - 1] = result;
+		}
+		// Otherwise it must be a number, which is pushed onto the stack
+		else if (parseLiteral(token, stack[top]))
+		{
+			++top;
 		}
 		else
 		{
 			// Any invalid token (including parentheses) => error
-			throw std::runtime_error("Error: invalid token: " + token);
+			throw std::runtime_error("Error: invalid token: " + std::string(token));
 		}
 	}
 
 	// If after processing all tokens, the stack doesn't have exactly 1 element, it's an error
-	if (st.size() != 1)
+	if (top != 1)
 		throw std::runtime_error("Error: invalid expression");
 
 	// The single remaining value on the stack is the result
-	return st.top();
+	return stack[0];
+}
+
+int RPN::evaluateStream(TokenReader &reader) {
+	std::vector<int> stack;
+	std::string_view token;
+	uint64_t offset = 0;
+	while (reader.nextToken(token, offset))
+	{
+		if (isOperator(token))
+		{
+			if (stack.size() < 2)
+				throw StreamError("Error: not enough operands for operator", offset);
+			const int b = stack.back();
+			stack.pop_back();
+			int &a = stack.back();
+			if (token[0] == '+')
+				a = add(a, b);
+			else if (token[0] == '-')
+				a = subtract(a, b);
+			else if (token[0] == '*')
+				a = multiply(a, b);
+			else if (b == 0)
+				throw StreamError("Error: division by zero", offset);
+			else
+				a = divide(a, b);
+		}
+		else
+		{
+			int value = 0;
+			if (!parseLiteral(token, value))
+				throw StreamError("Error: invalid token: " + std::string(token), offset);
+			stack.push_back(value);
+		}
+	}
+
+	if (stack.size() != 1)
+		throw StreamError("Error: invalid expression", reader.offset());
+	return stack[0];
+}
+
+int RPN::Program::slotOf(const std::string_view name) const {
+	for (size_t i = 0; i < variables.size(); ++i)
+	{
+		if (variables[i] == name)
+			return static_cast<int>(i);
+	}
+	return -1;
+}
+
+RPN::Program RPN::compile(const std::string &expression) {
+	Program program;
+	size_t depth = 0;
+	bool divided = false;
+
+	// Reports message now, or as a Trap when a division might fail first at run time
+	const auto fail = [&program, &divided](const std::string &message) {
+		if (!divided)
+			throw std::runtime_error(message);
+		program.code.push_back({ OpCode::Trap, 0 });
+		program.trapMessage = message;
+	};
+
+	const std::string_view text(expression);
+	std::string_view token;
+	for (size_t pos = 0; nextToken(text, pos, token);)
+	{
+		int literal = 0;
+		if (isOperator(token))
+		{
+			if (depth < 2)
+			{
+				fail("Error: not enough operands for operator");
+				return program;
+			}
+			static const OpCode operators[] = { OpCode::Add, OpCode::Sub, OpCode::Mul, OpCode::Div };
+			program.code.push_back({ operators[std::string_view("+-*/").find(token[0])], 0 });
+			divided = divided || token[0] == '/';
+			--depth;
+		}
+		else if (parseLiteral(token, literal))
+		{
+			program.code.push_back({ OpCode::Push, literal });
+			++depth;
+		}
+		else if (isIdentifier(token))
+		{
+			int slot = program.slotOf(token);
+			if (slot < 0)
+			{
+				slot = static_cast<int>(program.variables.size());
+				program.variables.emplace_back(token);
+			}
+			program.code.push_back({ OpCode::Load, slot });
+			++depth;
+		}
+		else
+		{
+			fail("Error: invalid token: " + std::string(token));
+			return program;
+		}
+		program.maxStack = std::max(program.maxStack, depth);
+	}
+
+	if (depth != 1)
+		fail("Error: invalid expression");
+	return program;
+}
+
+namespace {
+	// What optimize() knows about one value on the stack, computed by the instructions from start up to the
+	// start of the next value
+	struct Operand {
+		size_t start;
+		bool constant;
+		int value;
+		bool mayFail; // divides by something only known at run time
+	};
+}
+
+static int fold(const RPN::OpCode op, const int a, const int b) {
+	if (op == RPN::OpCode::Add)
+		return add(a, b);
+	if (op == RPN::OpCode::Sub)
+		return subtract(a, b);
+	if (op == RPN::OpCode::Mul)
+		return multiply(a, b);
+	return divide(a, b);
+}
+
+size_t RPN::optimize(Program &program) {
+	std::vector<Instruction> code;
+	std::vector<Operand> stack;
+	for (const Instruction &instruction: program.code)
+	{
+		if (instruction.op == OpCode::Push || instruction.op == OpCode::Load)
+		{
+			stack.push_back({ code.size(), instruction.op == OpCode::Push, instruction.operand, false });
+			code.push_back(instruction);
+			continue;
+		}
+		if (instruction.op == OpCode::Trap)
+		{
+			code.push_back(instruction);
+			break;
+		}
+
+		const Operand b = stack.back();
+		stack.pop_back();
+		Operand &a = stack.back();
+		const OpCode op = instruction.op;
+
+		if (op == OpCode::Div && b.constant && b.value == 0)
+		{
+			// Fails whenever it runs, so only the divisions that could fail before it still matter
+			std::vector<Instruction> kept;
+			for (size_t i = 0; i < stack.size(); ++i)
+			{
+				const size_t end = i + 1 < stack.size() ? stack[i + 1].start : b.start;
+				if (stack[i].mayFail)
+					kept.insert(kept.end(), code.begin() + stack[i].start, code.begin() + end);
+			}
+			code = std::move(kept);
+			code.push_back({ OpCode::Trap, 0 });
+			program.trapMessage = "Error: division by zero";
+			break;
+		}
+
+		if (a.constant && b.constant)
+		{
+			a.value = fold(op, a.value, b.value);
+			code.resize(a.start);
+			code.push_back({ OpCode::Push, a.value });
+		}
+		// x 0 +, x 0 -, x 1 *, x 1 /
+		else if (b.constant && (b.value == 0 ? op == OpCode::Add || op == OpCode::Sub
+		                                     : b.value == 1 && (op == OpCode::Mul || op == OpCode::Div)))
+		{
+			code.resize(b.start);
+		}
+		// 0 x +, 1 x *
+		else if (a.constant && (a.value == 0 ? op == OpCode::Add : a.value == 1 && op == OpCode::Mul))
+		{
+			code.erase(code.begin() + static_cast<std::ptrdiff_t>(a.start));
+			a.constant = false;
+			a.mayFail = b.mayFail;
+		}
+		// x 0 * and 0 x *, unless x could fail first
+		else if (op == OpCode::Mul && ((b.constant && b.value == 0 && !a.mayFail)
+		                               || (a.constant && a.value == 0 && !b.mayFail)))
+		{
+			code.resize(a.start);
+			code.push_back({ OpCode::Push, 0 });
+			a = { a.start, true, 0, false };
+		}
+		else
+		{
+			code.push_back(instruction);
+			a.mayFail = a.mayFail || b.mayFail || (op == OpCode::Div && !b.constant);
+			a.constant = false;
+		}
+	}
+
+	// Folding can only lower the stack depth
+	size_t depth = 0;
+	program.maxStack = 0;
+	for (const Instruction &instruction: code)
+	{
+		if (instruction.op == OpCode::Push || instruction.op == OpCode::Load)
+			program.maxStack = std::max(program.maxStack, ++depth);
+		else if (instruction.op != OpCode::Trap)
+			--depth;
+	}
+
+	const size_t removed = program.code.size() - code.size();
+	program.code = std::move(code);
+	return removed;
+}
+
+int RPN::execute(const Program &program, const int *bindings) {
+	// Compiled programs never underflow, so the stack needs no checks beyond its size
+	int inlineStack[RPN_INLINE_STACK];
+	inlineStack[0] = 0; // every compiled program sets it, but the compiler cannot tell
+	std::vector<int> heapStack;
+	int *stack = inlineStack;
+	if (program.maxStack > RPN_INLINE_STACK)
+	{
+		heapStack.resize(program.maxStack);
+		stack = heapStack.data();
+	}
+
+	size_t top = 0;
+	for (const Instruction &instruction: program.code)
+	{
+		switch (instruction.op)
+		{
+			case OpCode::Push:
+				stack[top++] = instruction.operand;
+				break;
+			case OpCode::Load:
+				stack[top++] = bindings[instruction.operand];
+				break;
+			case OpCode::Add:
+				--top;
+				stack[top - 1] = add(stack[top - 1], stack[top]);
+				break;
+			case OpCode::Sub:
+				--top;
+				stack[top - 1] = subtract(stack[top - 1], stack[top]);
+				break;
+			case OpCode::Mul:
+				--top;
+				stack[top - 1] = multiply(stack[top - 1], stack[top]);
+				break;
+			case OpCode::Div:
+				--top;
+				stack[top - 1] = divide(stack[top - 1], stack[top]);
+				break;
+			case OpCode::Trap:
+				throw std::runtime_error(program.trapMessage);
+		}
+	}
+	return stack[0];
+}
+
+namespace {
+	struct BatchChunk {
+		std::vector<std::string> lines;
+		std::string text;
+	};
+}
+
+static void evaluateChunk(BatchChunk &chunk) {
+	char buffer[16];
+	for (const std::string &line: chunk.lines)
+	{
+		try
+		{
+			const int result = RPN::evaluate(line);
+			chunk.text.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), result).ptr);
+		}
+		catch (const std::exception &e)
+		{
+			chunk.text += e.what();
+		}
+		chunk.text += '\n';
+	}
+}
+
+size_t RPN::evaluateLines(std::istream &input, std::ostream &output, const unsigned threads) {
+	// Chunks are evaluated concurrently and written in order, with at most a few per thread in flight
+	ThreadPool pool(threads);
+	std::deque<std::pair<std::unique_ptr<BatchChunk>, std::future<void> > > inFlight;
+	const size_t window = static_cast<size_t>(threads) * 4;
+	size_t count = 0;
+
+	for (bool more = true; more;)
+	{
+		auto chunk = std::make_unique<BatchChunk>();
+		std::string line;
+		while (chunk->lines.size() < RPN_BATCH_CHUNK_LINES && std::getline(input, line))
+			chunk->lines.push_back(std::move(line));
+		more = chunk->lines.size() == RPN_BATCH_CHUNK_LINES;
+		if (!chunk->lines.empty())
+		{
+			count += chunk->lines.size();
+			BatchChunk *task = chunk.get();
+			std::future<void> done = pool.submit([task] { evaluateChunk(*task); });
+			inFlight.emplace_back(std::move(chunk), std::move(done));
+		}
+
+		while (!inFlight.empty() && (!more || inFlight.size() >= window))
+		{
+			inFlight.front().second.get();
+			output.write(inFlight.front().first->text.data(),
+			             static_cast<std::streamsize>(inFlight.front().first->text.size()));
+			inFlight.pop_front();
+		}
+	}
+	output.flush();
+	return count;
 }
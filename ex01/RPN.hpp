@@ -1,13 +1,87 @@
-
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <vector>
+
+// Programs whose stack fits here run without allocating
+#define RPN_INLINE_STACK 256
+
+// Lines per task of evaluateLines
+#define RPN_BATCH_CHUNK_LINES 4096
+
+class TokenReader;
 
 class RPN {
 public:
+	// An error of evaluateStream(), with where it happened
+	class StreamError : public std::runtime_error {
+		uint64_t _offset;
+
+	public:
+		StreamError(const std::string &message, const uint64_t offset) : std::runtime_error(message), _offset(offset) {}
+
+		// Byte offset of the token at fault, or the length of the input when it ends too early
+		[[nodiscard]] uint64_t offset() const { return _offset; }
+	};
+
+	enum class OpCode : unsigned char {
+		Push, // push operand
+		Load, // push bindings[operand]
+		Add,
+		Sub,
+		Mul,
+		Div,
+		Trap // throw trapMessage: an error evaluate() only reports once the operations before it succeed
+	};
+
+	struct Instruction {
+		OpCode op;
+		int operand;
+	};
+
+	// A validated expression, ready to be executed any number of times
+	struct Program {
+		std::vector<Instruction> code;
+		std::vector<std::string> variables; // one slot per name, in order of first use
+		size_t maxStack = 0;
+		std::string trapMessage;
+
+		// Slot of a variable, or -1 if the expression does not use it
+		[[nodiscard]] int slotOf(std::string_view name) const;
+	};
+
 	RPN() = delete;
 	~RPN() = delete;
 	RPN(const RPN &other) = delete;
 	RPN &operator=(const RPN &other) = delete;
 
+	// Operands are decimal ints, such as 7, 42 or -3, and arithmetic wraps around on overflow. Does not
+	// allocate unless the expression has more than RPN_INLINE_STACK operands, or is invalid.
 	static int evaluate(const std::string &expression);
+
+	// Parses and validates expression once. Identifiers ([A-Za-z_][A-Za-z0-9_]*) become variables; the other
+	// tokens are the ones evaluate() accepts. Throws the error evaluate() would report, unless a division
+	// comes first: its divisor is only known when executing, so the error becomes a Trap instead.
+	static Program compile(const std::string &expression);
+
+	// Rewrites program into fewer instructions with the same results and errors for every binding: folds
+	// constant subexpressions, drops identities such as x 1 * or x 0 +, and turns a division by a constant
+	// zero into a Trap. Variable slots stay as they are. Returns the number of instructions removed.
+	static size_t optimize(Program &program);
+
+	// Runs program with bindings[slot] as the value of each variable; same results and errors as evaluate()
+	static int execute(const Program &program, const int *bindings = nullptr);
+
+	// Evaluates a single expression of any size, read token by token, so that only the operand stack is held
+	// in memory. Same results and errors as evaluate(), thrown as StreamError.
+	static int evaluateStream(TokenReader &reader);
+
+	// Evaluates one expression per line of input on threads threads and writes one line per expression to
+	// output, its result or its error, in input order. Returns the number of expressions.
+	static size_t evaluateLines(std::istream &input, std::ostream &output, unsigned threads);
 };
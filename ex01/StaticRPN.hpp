@@ -0,0 +1,257 @@
+#pragma once
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <stdexcept>
+
+#include "RPN.hpp"
+
+// The constexpr parser behind StaticRPN, with the same tokens and arithmetic as RPN::compile and RPN::execute
+class StaticRPNParser {
+public:
+	enum class Error {
+		None,
+		InvalidToken,
+		NotEnoughOperands,
+		InvalidExpression,
+		DivisionByZero // by a divisor known at compile time
+	};
+
+	// Instructions for an expression of at most Tokens tokens
+	template<size_t Tokens>
+	struct Parsed {
+		std::array<RPN::Instruction, Tokens> code{};
+		size_t size = 0;
+		size_t variables = 0;
+		size_t maxStack = 0;
+		Error error = Error::None;
+		int value = 0; // the result, when variables is 0
+	};
+
+	StaticRPNParser() = delete;
+	~StaticRPNParser() = delete;
+	StaticRPNParser(const StaticRPNParser &other) = delete;
+	StaticRPNParser &operator=(const StaticRPNParser &other) = delete;
+
+	static constexpr bool isSpace(const char c) {
+		return c == ' ' || (c >= '\t' && c <= '\r');
+	}
+
+	static constexpr size_t countTokens(const char *expression) {
+		size_t tokens = 0;
+		for (size_t i = 0; expression[i] != '\0'; ++i)
+		{
+			if (!isSpace(expression[i]) && (i == 0 || isSpace(expression[i - 1])))
+				++tokens;
+		}
+		return tokens;
+	}
+
+	// Wraps around like RPN::execute; only called with a zero divisor at run time
+	static constexpr int apply(const RPN::OpCode op, const int a, const int b) {
+		const unsigned left = static_cast<unsigned>(a);
+		const unsigned right = static_cast<unsigned>(b);
+		if (op == RPN::OpCode::Add)
+			return static_cast<int>(left + right);
+		if (op == RPN::OpCode::Sub)
+			return static_cast<int>(left - right);
+		if (op == RPN::OpCode::Mul)
+			return static_cast<int>(left * right);
+		if (b == 0)
+			throw std::runtime_error("Error: division by zero");
+		return b == -1 ? static_cast<int>(0u - left) : a / b;
+	}
+
+	// A decimal int, optionally negative, as RPN::evaluate accepts it
+	static constexpr bool parseLiteral(const char *token, const size_t length, int &value) {
+		const bool negative = token[0] == '-';
+		if (length == static_cast<size_t>(negative))
+			return false;
+		long long magnitude = 0;
+		for (size_t i = negative; i < length; ++i)
+		{
+			if (token[i] < '0' || token[i] > '9')
+				return false;
+			magnitude = magnitude * 10 + (token[i] - '0');
+			if (magnitude > static_cast<long long>(INT_MAX) + 1)
+				return false;
+		}
+		if (!negative && magnitude > INT_MAX)
+			return false;
+		value = static_cast<int>(negative ? -magnitude : magnitude);
+		return true;
+	}
+
+	static constexpr bool isIdentifier(const char *token, const size_t length) {
+		for (size_t i = 0; i < length; ++i)
+		{
+			const char c = token[i];
+			const bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+			if (!letter && (i == 0 || c < '0' || c > '9'))
+				return false;
+		}
+		return length != 0;
+	}
+
+	static constexpr bool sameToken(const char *a, const size_t aLength, const char *b, const size_t bLength) {
+		if (aLength != bLength)
+			return false;
+		for (size_t i = 0; i < aLength; ++i)
+		{
+			if (a[i] != b[i])
+				return false;
+		}
+		return true;
+	}
+
+	// Compiles expression like RPN::compile, except that every error is reported, and that values computed
+	// from constants only are tracked so that a constant zero divisor is caught too
+	template<size_t Tokens>
+	static constexpr Parsed<Tokens> parse(const char *expression) {
+		Parsed<Tokens> parsed;
+		std::array<const char *, Tokens> names{};
+		std::array<size_t, Tokens> nameLengths{};
+		std::array<int, Tokens> known{}; // value of each stack entry, when it only depends on constants
+		std::array<bool, Tokens> isKnown{};
+		size_t depth = 0;
+
+		for (size_t pos = 0;;)
+		{
+			while (isSpace(expression[pos]))
+				++pos;
+			if (expression[pos] == '\0')
+				break;
+			const char *token = expression + pos;
+			while (expression[pos] != '\0' && !isSpace(expression[pos]))
+				++pos;
+			const size_t length = static_cast<size_t>(expression + pos - token);
+
+			RPN::Instruction instruction{ RPN::OpCode::Push, 0 };
+			if (length == 1 && (token[0] == '+' || token[0] == '-' || token[0] == '*' || token[0] == '/'))
+			{
+				if (depth < 2)
+				{
+					parsed.error = Error::NotEnoughOperands;
+					return parsed;
+				}
+				instruction.op = token[0] == '+' ? RPN::OpCode::Add : token[0] == '-' ? RPN::OpCode::Sub
+					: token[0] == '*' ? RPN::OpCode::Mul : RPN::OpCode::Div;
+				--depth;
+				if (instruction.op == RPN::OpCode::Div && isKnown[depth] && known[depth] == 0)
+				{
+					parsed.error = Error::DivisionByZero;
+					return parsed;
+				}
+				if (isKnown[depth - 1] && isKnown[depth])
+					known[depth - 1] = apply(instruction.op, known[depth - 1], known[depth]);
+				else
+					isKnown[depth - 1] = false;
+			}
+			else if (parseLiteral(token, length, instruction.operand))
+			{
+				known[depth] = instruction.operand;
+				isKnown[depth++] = true;
+			}
+			else if (isIdentifier(token, length))
+			{
+				size_t slot = 0;
+				while (slot < parsed.variables && !sameToken(names[slot], nameLengths[slot], token, length))
+					++slot;
+				if (slot == parsed.variables)
+				{
+					names[slot] = token;
+					nameLengths[slot] = length;
+					++parsed.variables;
+				}
+				instruction = { RPN::OpCode::Load, static_cast<int>(slot) };
+				isKnown[depth++] = false;
+			}
+			else
+			{
+				parsed.error = Error::InvalidToken;
+				return parsed;
+			}
+			parsed.code[parsed.size++] = instruction;
+			if (depth > parsed.maxStack)
+				parsed.maxStack = depth;
+		}
+
+		if (depth != 1)
+			parsed.error = Error::InvalidExpression;
+		else
+			parsed.value = known[0];
+		return parsed;
+	}
+};
+
+// An RPN expression fixed at build time, given as a constexpr char array:
+//
+//     static constexpr char area[] = "w h *";
+//     int a = StaticRPN<area>::evaluate(width, height);
+//
+// An expression of constants only is evaluated by the compiler. Otherwise evaluate() takes one int per
+// variable, in order of first use, and compiles to straight-line code for this expression. An invalid
+// expression, or a division by a constant zero, does not compile.
+template<const char *Expression>
+class StaticRPN {
+	static constexpr size_t tokens = StaticRPNParser::countTokens(Expression) + 1;
+	static constexpr StaticRPNParser::Parsed<tokens> program = StaticRPNParser::parse<tokens>(Expression);
+
+	static_assert(program.error != StaticRPNParser::Error::InvalidToken, "Error: invalid token");
+	static_assert(program.error != StaticRPNParser::Error::NotEnoughOperands,
+	              "Error: not enough operands for operator");
+	static_assert(program.error != StaticRPNParser::Error::InvalidExpression, "Error: invalid expression");
+	static_assert(program.error != StaticRPNParser::Error::DivisionByZero, "Error: division by zero");
+
+	// One instantiation per instruction, with the stack depth known at each
+	template<size_t Index, size_t Top>
+	static constexpr int run(int *stack, const int *bindings) {
+		if constexpr (Index == program.size)
+		{
+			return stack[0];
+		}
+		else
+		{
+			constexpr RPN::Instruction instruction = program.code[Index];
+			if constexpr (instruction.op == RPN::OpCode::Push)
+			{
+				stack[Top] = instruction.operand;
+				return run<Index + 1, Top + 1>(stack, bindings);
+			}
+			else if constexpr (instruction.op == RPN::OpCode::Load)
+			{
+				stack[Top] = bindings[instruction.operand];
+				return run<Index + 1, Top + 1>(stack, bindings);
+			}
+			else
+			{
+				stack[Top - 2] = StaticRPNParser::apply(instruction.op, stack[Top - 2], stack[Top - 1]);
+				return run<Index + 1, Top - 1>(stack, bindings);
+			}
+		}
+	}
+
+public:
+	static constexpr size_t variables = program.variables;
+
+	StaticRPN() = delete;
+	~StaticRPN() = delete;
+	StaticRPN(const StaticRPN &other) = delete;
+	StaticRPN &operator=(const StaticRPN &other) = delete;
+
+	// Same result and errors as RPN::execute with these bindings
+	template<typename... Values>
+	static constexpr int evaluate(const Values... values) {
+		static_assert(sizeof...(Values) == variables, "one value per variable, in order of first use");
+		if constexpr (variables == 0)
+		{
+			return program.value;
+		}
+		else
+		{
+			const int bindings[] = { static_cast<int>(values)... };
+			int stack[program.maxStack] = {};
+			return run<0, 0>(stack, bindings);
+		}
+	}
+};
@@ -0,0 +1,44 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(const unsigned threadCount) {
+	_workers.reserve(threadCount);
+	for (unsigned i = 0; i < threadCount; ++i) {
+		_workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_cv.notify_all();
+	for (std::thread &worker: _workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::workerLoop() {
+	for (;;) {
+		std::packaged_task<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_cv.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+			if (_tasks.empty()) return;
+			task = std::move(_tasks.front());
+			_tasks.pop();
+		}
+		task();
+	}
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+	std::packaged_task<void()> packaged(std::move(task));
+	std::future<void> future = packaged.get_future();
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_tasks.push(std::move(packaged));
+	}
+	_cv.notify_one();
+	return future;
+}
@@ -0,0 +1,118 @@
+#include "TokenReader.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Same whitespace as operator>> on a std::string
+static bool isSpace(const char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+TokenReader::TokenReader(const std::string &path) {
+	if (path == "-")
+	{
+		_fd = STDIN_FILENO;
+		_ownsFd = false;
+	}
+	else
+	{
+		_fd = open(path.c_str(), O_RDONLY);
+		if (_fd == -1)
+			return;
+	}
+	mapOrBuffer();
+}
+
+TokenReader::TokenReader(const int fd) : _fd(fd), _ownsFd(false) {
+	mapOrBuffer();
+}
+
+void TokenReader::mapOrBuffer() {
+	struct stat st = {};
+	if (fstat(_fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+	{
+		void *data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, _fd, 0);
+		if (data != MAP_FAILED)
+		{
+			madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+			_mapped = static_cast<const char *>(data);
+			_mappedSize = static_cast<size_t>(st.st_size);
+			_end = _mappedSize;
+			_eof = true;
+			return;
+		}
+	}
+
+	// Not mappable: fall back to buffered reads
+	_buffer.resize(TOKEN_READER_CHUNK_SIZE);
+}
+
+TokenReader::~TokenReader() {
+	if (_mapped)
+		munmap(const_cast<char *>(_mapped), _mappedSize);
+	if (_ownsFd && _fd != -1)
+		close(_fd);
+}
+
+// Keeps the bytes from _begin on, at the front of the buffer, and reads more after them
+void TokenReader::fill() {
+	if (_begin > 0)
+	{
+		std::memmove(_buffer.data(), _buffer.data() + _begin, _end - _begin);
+		_bufferOffset += _begin;
+		_end -= _begin;
+		_begin = 0;
+	}
+	if (_end == _buffer.size())
+		_buffer.resize(_buffer.size() * 2); // a single token longer than the buffer
+
+	ssize_t n;
+	do
+	{
+		n = read(_fd, _buffer.data() + _end, _buffer.size() - _end);
+	}
+	while (n == -1 && errno == EINTR);
+
+	if (n <= 0)
+		_eof = true;
+	else
+		_end += static_cast<size_t>(n);
+}
+
+bool TokenReader::nextToken(std::string_view &token, uint64_t &offset) {
+	const char *data = _mapped ? _mapped : _buffer.data();
+	for (;;)
+	{
+		while (_begin < _end && isSpace(data[_begin]))
+			++_begin;
+		if (_begin < _end || _eof)
+			break;
+		_begin = _end; // whitespace only: nothing to keep
+		fill();
+		data = _buffer.data();
+	}
+	if (_begin == _end)
+		return false;
+
+	// A token ends at whitespace, or at the end of the file, but not at the end of the buffer
+	size_t end = _begin;
+	for (;;)
+	{
+		while (end < _end && !isSpace(data[end]))
+			++end;
+		if (end < _end || _eof)
+			break;
+		end -= _begin; // fill() moves the token to the front
+		fill();
+		data = _buffer.data();
+	}
+
+	token = std::string_view(data + _begin, end - _begin);
+	offset = _bufferOffset + _begin;
+	_begin = end;
+	return true;
+}
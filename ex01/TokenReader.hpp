@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define TOKEN_READER_CHUNK_SIZE (64 * 1024)
+
+// Splits a file into whitespace-separated tokens without holding all of it in memory. Regular files are
+// memory-mapped; pipes, terminals and stdin (path "-") are read in chunks into a buffer that is reused for
+// the whole file, and only grows for a token longer than it.
+class TokenReader {
+	int _fd = -1;
+	bool _ownsFd = true;
+
+	const char *_mapped = nullptr;
+	size_t _mappedSize = 0;
+
+	std::vector<char> _buffer;
+	size_t _begin = 0;
+	size_t _end = 0;
+	bool _eof = false;
+	uint64_t _bufferOffset = 0; // file offset of _buffer[0], in buffered mode
+
+	void fill();
+
+	void mapOrBuffer();
+
+public:
+	explicit TokenReader(const std::string &path);
+
+	// Reads from an already open descriptor, such as a pipe, without taking ownership of it
+	explicit TokenReader(int fd);
+
+	~TokenReader();
+
+	TokenReader(const TokenReader &other) = delete;
+
+	TokenReader &operator=(const TokenReader &other) = delete;
+
+	[[nodiscard]] bool isOpen() const { return _fd != -1; }
+
+	// The returned view stays valid until the next call; offset is where it starts in the file
+	bool nextToken(std::string_view &token, uint64_t &offset);
+
+	// Position in the file just past the last token returned, or the end of the file once there are none
+	[[nodiscard]] uint64_t offset() const { return _bufferOffset + _begin; }
+};
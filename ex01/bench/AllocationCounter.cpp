@@ -0,0 +1,25 @@
+#include "AllocationCounter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+static size_t allocations = 0;
+
+void *operator new(const size_t size) {
+	++allocations;
+	if (void *memory = std::malloc(size ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+	std::free(memory);
+}
+
+size_t AllocationCounter::count() {
+	return allocations;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+
+// Counts heap allocations: AllocationCounter.cpp replaces the global operator new and delete of every
+// benchmark that links it, so only link it where the count is wanted
+class AllocationCounter {
+public:
+	AllocationCounter() = delete;
+
+	~AllocationCounter() = delete;
+
+	AllocationCounter(const AllocationCounter &other) = delete;
+
+	AllocationCounter &operator=(const AllocationCounter &other) = delete;
+
+	// Calls to operator new since the program started
+	static size_t count();
+};
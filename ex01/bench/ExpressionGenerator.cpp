@@ -0,0 +1,272 @@
+#include "ExpressionGenerator.hpp"
+
+#include <utility>
+#include <vector>
+
+// Tokens RPN::evaluate is easy to get wrong on
+static const char *const edgeTokens[] = {
+	"+", "-", "*", "/", "0", "-0", "-1", "1", "9", "00", "007", "2147483647", "-2147483648", "2147483648",
+	"-2147483649", "--1", "+1", "1a", "a1", "x", "(", ")", "1.5", "//", "+-"
+};
+
+// Tokens RPN::evaluate always rejects
+static const char *const invalidTokens[] = { "x", "(", "1.5", "2147483648", "--1" };
+
+static const char *const separators[] = { " ", " ", " ", " ", "  ", "\t", "\n", "\v", "\f", "\r", " \t " };
+
+template<size_t Size>
+static const char *pick(const char *const (&choices)[Size], std::mt19937 &rng) {
+	return choices[std::uniform_int_distribution<size_t>(0, Size - 1)(rng)];
+}
+
+namespace {
+	// Appends tokens while tracking the values on the stack, to keep valid expressions from dividing by zero
+	class Emitter {
+		const ExpressionProfile &_profile;
+		const std::string _operators;
+		std::mt19937 &_rng;
+		std::string &_text;
+		std::vector<int> _stack;
+		std::vector<bool> _known; // false for a value that depends on a variable
+
+		void append(const std::string &token) {
+			if (!_text.empty())
+				_text += ' ';
+			_text += token;
+		}
+
+	public:
+		Emitter(const ExpressionProfile &profile, std::mt19937 &rng, std::string &text)
+			: _profile(profile), _operators(profile.operators.empty() ? "+" : profile.operators), _rng(rng),
+			  _text(text) {}
+
+		[[nodiscard]] size_t depth() const { return _stack.size(); }
+
+		void operand() {
+			if (_profile.variables > 0 && std::uniform_real_distribution<double>(0, 1)(_rng) < _profile.variableRatio)
+			{
+				_stack.push_back(0);
+				_known.push_back(false);
+				append(ExpressionGenerator::variableName(
+					std::uniform_int_distribution<size_t>(0, _profile.variables - 1)(_rng)));
+				return;
+			}
+			const int value = std::uniform_int_distribution<int>(0, _profile.maxLiteral)(_rng);
+			_stack.push_back(value);
+			_known.push_back(true);
+			append(std::to_string(value));
+		}
+
+		void operation() {
+			char op = _operators[std::uniform_int_distribution<size_t>(0, _operators.size() - 1)(_rng)];
+			const int b = _stack.back();
+			const bool known = _known.back() && _known[_known.size() - 2];
+			const bool knownDivisor = _known.back();
+			_stack.pop_back();
+			_known.pop_back();
+			_known.back() = known;
+			const int a = _stack.back();
+			if (op == '/' && knownDivisor && b == 0)
+			{
+				const size_t other = _operators.find_first_not_of('/');
+				op = other == std::string::npos ? '+' : _operators[other];
+			}
+
+			// Wraps around like RPN::evaluate
+			const unsigned left = static_cast<unsigned>(a);
+			const unsigned right = static_cast<unsigned>(b);
+			if (op == '+')
+				_stack.back() = static_cast<int>(left + right);
+			else if (op == '-')
+				_stack.back() = static_cast<int>(left - right);
+			else if (op == '*')
+				_stack.back() = static_cast<int>(left * right);
+			else if (b != 0)
+				_stack.back() = b == -1 ? static_cast<int>(0u - left) : a / b;
+			append(std::string(1, op));
+		}
+
+		// A complete binary tree of operands leaves
+		void balanced(const size_t operands) {
+			if (operands <= 1)
+			{
+				operand();
+				return;
+			}
+			balanced(operands / 2);
+			balanced(operands - operands / 2);
+			operation();
+		}
+	};
+}
+
+// Inserts token after a random token of expression, or at its start when there is none
+static void insertToken(std::string &expression, const std::string &token, std::mt19937 &rng) {
+	std::vector<size_t> ends;
+	for (size_t i = 0; i < expression.size(); ++i)
+	{
+		if (expression[i] != ' ' && (i + 1 == expression.size() || expression[i + 1] == ' '))
+			ends.push_back(i + 1);
+	}
+	if (ends.empty())
+	{
+		expression = token;
+		return;
+	}
+	const size_t at = ends[std::uniform_int_distribution<size_t>(0, ends.size() - 1)(rng)];
+	expression.insert(at, " " + token);
+}
+
+std::string ExpressionGenerator::generate(const ExpressionProfile &profile, std::mt19937 &rng) {
+	std::string expression;
+	Emitter emitter(profile, rng, expression);
+	const size_t operands = profile.operands == 0 ? 1 : profile.operands;
+
+	switch (profile.depth)
+	{
+		case DepthProfile::Shallow:
+			emitter.operand();
+			for (size_t i = 1; i < operands; ++i)
+			{
+				emitter.operand();
+				emitter.operation();
+			}
+			break;
+		case DepthProfile::Deep:
+			for (size_t i = 0; i < operands; ++i)
+				emitter.operand();
+			for (size_t i = 1; i < operands; ++i)
+				emitter.operation();
+			break;
+		case DepthProfile::Balanced:
+			emitter.balanced(operands);
+			break;
+		case DepthProfile::Random:
+			for (size_t remaining = operands; remaining > 0 || emitter.depth() > 1;)
+			{
+				if (remaining > 0 && (emitter.depth() < 2 || rng() % 2 == 0))
+				{
+					emitter.operand();
+					--remaining;
+				}
+				else
+				{
+					emitter.operation();
+				}
+			}
+			break;
+	}
+
+	if (std::uniform_real_distribution<double>(0, 1)(rng) >= profile.errorRatio)
+		return expression;
+	switch (rng() % 4)
+	{
+		case 0:
+			insertToken(expression, pick(invalidTokens, rng), rng); // invalid token
+			break;
+		case 1:
+			insertToken(expression, "0 /", rng); // division by zero
+			break;
+		case 2:
+			expression += " +"; // not enough operands
+			break;
+		default:
+			expression += " 1"; // invalid expression
+			break;
+	}
+	return expression;
+}
+
+std::string ExpressionGenerator::mutate(const std::string &expression, std::mt19937 &rng) {
+	std::vector<std::string> tokens;
+	for (size_t pos = 0; pos < expression.size();)
+	{
+		const size_t end = expression.find(' ', pos);
+		const size_t length = (end == std::string::npos ? expression.size() : end) - pos;
+		if (length > 0)
+			tokens.push_back(expression.substr(pos, length));
+		pos += length + 1;
+	}
+
+	const int mutations = std::uniform_int_distribution<int>(1, 3)(rng);
+	for (int i = 0; i < mutations; ++i)
+	{
+		const size_t at = tokens.empty() ? 0 : std::uniform_int_distribution<size_t>(0, tokens.size() - 1)(rng);
+		switch (tokens.empty() ? 3 : rng() % 4)
+		{
+			case 0:
+				tokens.erase(tokens.begin() + static_cast<std::ptrdiff_t>(at));
+				break;
+			case 1:
+				tokens.insert(tokens.begin() + static_cast<std::ptrdiff_t>(at), tokens[at]);
+				break;
+			case 2:
+				if (at + 1 < tokens.size())
+					std::swap(tokens[at], tokens[at + 1]);
+				break;
+			default:
+				if (tokens.empty())
+					tokens.emplace_back(pick(edgeTokens, rng));
+				else
+					tokens[at] = pick(edgeTokens, rng);
+				break;
+		}
+	}
+
+	std::string mutated = rng() % 4 == 0 ? pick(separators, rng) : "";
+	for (size_t i = 0; i < tokens.size(); ++i)
+	{
+		if (i > 0)
+			mutated += pick(separators, rng);
+		mutated += tokens[i];
+	}
+	if (rng() % 4 == 0)
+		mutated += pick(separators, rng);
+	return mutated;
+}
+
+std::string ExpressionGenerator::variableName(const size_t i) {
+	static const char *const names[] = { "x", "y", "z" };
+	return i < 3 ? names[i] : "v" + std::to_string(i);
+}
+
+size_t ExpressionGenerator::countTokens(const std::string &expression) {
+	size_t tokens = 0;
+	for (size_t i = 0; i < expression.size(); ++i)
+	{
+		const bool space = expression[i] == ' ' || (expression[i] >= '\t' && expression[i] <= '\r');
+		const bool previousSpace = i == 0 || expression[i - 1] == ' '
+			|| (expression[i - 1] >= '\t' && expression[i - 1] <= '\r');
+		if (!space && previousSpace)
+			++tokens;
+	}
+	return tokens;
+}
+
+bool ExpressionGenerator::parseDepth(const std::string &name, DepthProfile &depth) {
+	for (const DepthProfile candidate: { DepthProfile::Shallow, DepthProfile::Deep, DepthProfile::Balanced,
+	                                     DepthProfile::Random })
+	{
+		if (name == depthName(candidate))
+		{
+			depth = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char *ExpressionGenerator::depthName(const DepthProfile depth) {
+	switch (depth)
+	{
+		case DepthProfile::Shallow:
+			return "shallow";
+		case DepthProfile::Deep:
+			return "deep";
+		case DepthProfile::Balanced:
+			return "balanced";
+		case DepthProfile::Random:
+			break;
+	}
+	return "random";
+}
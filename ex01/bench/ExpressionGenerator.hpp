@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <random>
+#include <string>
+
+// Synthetic RPN expressions, shared by rpn_gen, rpn_bench and rpn_fuzz
+
+enum class DepthProfile {
+	Shallow, // a b op c op d op ...: the stack never holds more than two values
+	Deep, // every operand, then every operator: the stack holds them all
+	Balanced, // a complete binary tree: the stack grows with log2 of the operands
+	Random // operators wherever the stack allows, each with even odds
+};
+
+struct ExpressionProfile {
+	size_t operands = 16;
+	std::string operators = "+-*/"; // drawn uniformly, so repeating one weighs it up
+	DepthProfile depth = DepthProfile::Random;
+	double errorRatio = 0; // share of expressions made invalid on purpose; the others never fail
+	int maxLiteral = 9; // literals are drawn from [0, maxLiteral]
+	size_t variables = 0; // operands may also be variables, named by ExpressionGenerator::variableName
+	double variableRatio = 0.5; // share of operands that are variables, when there are any
+};
+
+class ExpressionGenerator {
+public:
+	ExpressionGenerator() = delete;
+
+	~ExpressionGenerator() = delete;
+
+	ExpressionGenerator(const ExpressionGenerator &other) = delete;
+
+	ExpressionGenerator &operator=(const ExpressionGenerator &other) = delete;
+
+	// One expression with single spaces between tokens. A valid one never divides by zero, unless by a
+	// variable: a division by zero is replaced with another operator. An invalid one has one of the errors
+	// RPN::evaluate reports. Only RPN::compile takes an expression with variables.
+	static std::string generate(const ExpressionProfile &profile, std::mt19937 &rng);
+
+	// Name of variable i of a profile: x, y, z, then v3, v4...
+	static std::string variableName(size_t i);
+
+	// expression with a few tokens deleted, duplicated, swapped or replaced with edge cases, and its spaces
+	// replaced with other whitespace
+	static std::string mutate(const std::string &expression, std::mt19937 &rng);
+
+	static size_t countTokens(const std::string &expression);
+
+	static bool parseDepth(const std::string &name, DepthProfile &depth);
+
+	static const char *depthName(DepthProfile depth);
+};
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../ColumnEvaluator.hpp"
+
+// Times RPN::execute row by row against each ColumnEvaluator kernel the CPU supports, and checks that every
+// row gets the same result or error
+
+#define ROWS 4000000
+
+// Divisors are zero about once per this many rows
+#define ZERO_DIVISOR_RATE 1000
+
+// Row by row, as a caller without ColumnEvaluator would
+static void executeRows(const RPN::Program &program, const std::vector<const int *> &columns,
+                        ColumnEvaluator::Result &result) {
+	std::vector<int> bindings(columns.size());
+	for (size_t row = 0; row < ROWS; ++row)
+	{
+		for (size_t slot = 0; slot < columns.size(); ++slot)
+			bindings[slot] = columns[slot][row];
+		try
+		{
+			result.values[row] = RPN::execute(program, bindings.data());
+			result.errors[row] = ColumnEvaluator::Error::None;
+		}
+		catch (const std::exception &e)
+		{
+			result.values[row] = 0;
+			result.errors[row] = e.what() == program.trapMessage ? ColumnEvaluator::Error::Trap
+				: ColumnEvaluator::Error::DivisionByZero;
+		}
+	}
+}
+
+template<typename Evaluate>
+static void run(const std::string &expression, const char *name, const ColumnEvaluator::Result &expected,
+                ColumnEvaluator::Result &result, Evaluate evaluate) {
+	// Best of a few runs over already touched result columns
+	double bestNs = 1e300;
+	for (int i = 0; i < 3; ++i)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		evaluate();
+		const auto end = std::chrono::steady_clock::now();
+		bestNs = std::min(bestNs, std::chrono::duration<double, std::nano>(end - start).count() / ROWS);
+	}
+	const bool same = result.values == expected.values && result.errors == expected.errors;
+	std::cout << std::setw(34) << expression << std::setw(10) << name << std::setw(12) << bestNs
+			<< (same ? "" : "  MISMATCH") << std::endl;
+}
+
+int main() {
+	const std::vector<std::string> expressions = {
+		"x y + z *",
+		"x 3 * y - z /",
+		"x y * z * x - 7 + y z - *",
+		"x y / z / 2 * x +",
+	};
+
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<int> anyValue(-1000000, 1000000);
+	std::uniform_int_distribution<int> zeroChance(1, ZERO_DIVISOR_RATE);
+	std::vector<std::vector<int> > columns(3, std::vector<int>(ROWS));
+	for (std::vector<int> &column: columns)
+	{
+		for (int &value: column)
+			value = zeroChance(rng) == 1 ? 0 : anyValue(rng);
+	}
+
+	std::cout << std::fixed << std::setprecision(3) << std::setw(34) << "expression" << std::setw(10) << "path"
+			<< std::setw(12) << "ns/row" << std::endl;
+	for (const std::string &expression: expressions)
+	{
+		const RPN::Program program = RPN::compile(expression);
+		std::vector<const int *> bindings;
+		for (const std::string &name: program.variables)
+			bindings.push_back(columns[name[0] - 'x'].data());
+
+		ColumnEvaluator::Result expected = { std::vector<int>(ROWS), std::vector<ColumnEvaluator::Error>(ROWS) };
+		executeRows(program, bindings, expected);
+		ColumnEvaluator::Result result = expected;
+		run(expression, "execute", expected, result, [&] { executeRows(program, bindings, result); });
+
+		for (const ColumnEvaluator::Kernel kernel: { ColumnEvaluator::Kernel::Scalar, ColumnEvaluator::Kernel::Avx2 })
+		{
+			if (!ColumnEvaluator::isSupported(kernel))
+			{
+				std::cout << std::setw(34) << expression << std::setw(10) << ColumnEvaluator::kernelName(kernel)
+						<< std::setw(12) << "unsupported" << std::endl;
+				continue;
+			}
+			std::fill(result.values.begin(), result.values.end(), -1);
+			run(expression, ColumnEvaluator::kernelName(kernel), expected, result, [&] {
+				ColumnEvaluator::evaluate(kernel, program, bindings.data(), ROWS, result.values.data(),
+				                          result.errors.data());
+			});
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,105 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stack>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../RPN.hpp"
+#include "../StaticRPN.hpp"
+#include "AllocationCounter.hpp"
+
+// Compares the former std::stack/istringstream evaluator with RPN::evaluate and RPN::execute, before and after
+// RPN::optimize, counting the heap allocations each one makes per evaluation, then StaticRPN on a formula
+// fixed at build time
+
+#define EVALUATIONS 1000000
+
+static constexpr char fixedFormula[] = "x y * z * x - 7 + y z - *";
+
+// The evaluator RPN::evaluate replaced, kept as the baseline
+static int legacyEvaluate(const std::string &expression) {
+	std::stack<int> st;
+	std::istringstream iss(expression);
+	std::string token;
+
+	while (iss >> token)
+	{
+		if (token.size() == 1 && (token[0] >= '0' && token[0] <= '9'))
+		{
+			st.push(token[0] - '0');
+		}
+		else if (token == "+" || token == "-" || token == "*" || token == "/")
+		{
+			if (st.size() < 2)
+				throw std::runtime_error("Error: not enough operands for operator");
+			const int b = st.top();
+			st.pop();
+			const int a = st.top();
+			st.pop();
+			if (token == "/" && b == 0)
+				throw std::runtime_error("Error: division by zero");
+			st.push(token == "+" ? a + b : token == "-" ? a - b : token == "*" ? a * b : a / b);
+		}
+		else
+		{
+			throw std::runtime_error("Error: invalid token: " + token);
+		}
+	}
+	if (st.size() != 1)
+		throw std::runtime_error("Error: invalid expression");
+	return st.top();
+}
+
+template<typename Evaluate>
+static void run(const char *name, const std::string &expression, Evaluate evaluate) {
+	long checksum = evaluate(); // warm-up, and first-call allocations out of the count
+	const size_t before = AllocationCounter::count();
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < EVALUATIONS; ++i)
+		checksum += evaluate();
+	const auto end = std::chrono::steady_clock::now();
+	const double ns = std::chrono::duration<double, std::nano>(end - start).count() / EVALUATIONS;
+	const double allocationsPerEvaluation = static_cast<double>(AllocationCounter::count() - before) / EVALUATIONS;
+
+	std::cout << std::setw(34) << expression << std::setw(10) << name << std::setw(12) << ns << std::setw(12)
+			<< allocationsPerEvaluation << std::setw(14) << checksum << std::endl;
+}
+
+int main() {
+	const std::vector<std::string> expressions = {
+		"8 9 * 9 - 9 - 9 - 4 - 1 +",
+		"7 7 * 7 -",
+		"1 2 * 2 / 2 * 2 4 - +",
+		"9 8 7 6 5 4 3 2 1 + + + + + + + +",
+	};
+
+	std::cout << std::fixed << std::setprecision(2) << std::setw(34) << "expression" << std::setw(10) << "path"
+			<< std::setw(12) << "ns/eval" << std::setw(12) << "allocs/eval" << std::setw(14) << "checksum"
+			<< std::endl;
+	for (const std::string &expression: expressions)
+	{
+		const RPN::Program program = RPN::compile(expression);
+		RPN::Program optimized = program;
+		RPN::optimize(optimized);
+		run("legacy", expression, [&expression] { return legacyEvaluate(expression); });
+		run("evaluate", expression, [&expression] { return RPN::evaluate(expression); });
+		run("execute", expression, [&program] { return RPN::execute(program); });
+		run("optimized", expression, [&optimized] { return RPN::execute(optimized); });
+	}
+
+	// Volatile so that the compiler cannot fold the variables away
+	volatile int x = 3;
+	volatile int y = 5;
+	volatile int z = 2;
+	const RPN::Program program = RPN::compile(fixedFormula);
+	run("execute", fixedFormula, [&] {
+		const int bindings[] = { x, y, z };
+		return RPN::execute(program, bindings);
+	});
+	run("static", fixedFormula, [&] { return StaticRPN<fixedFormula>::evaluate(x, y, z); });
+	return 0;
+}
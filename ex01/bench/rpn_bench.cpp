@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../RPN.hpp"
+#include "AllocationCounter.hpp"
+#include "ExpressionGenerator.hpp"
+
+// Runs RPN::evaluate over a matrix of generated expression sets and prints one CSV row per set on stdout:
+// evaluations/s, tokens/s and heap allocations per evaluation, the best of --repeat passes over the set.
+// Usage: rpn_bench [--tokens N] [--repeat N] [--operators MIX] [--seed N]
+
+namespace {
+	struct Pass {
+		double seconds = 0;
+		size_t allocations = 0;
+		size_t errors = 0;
+	};
+}
+
+static Pass evaluateAll(const std::vector<std::string> &expressions, long &checksum) {
+	Pass pass;
+	const size_t before = AllocationCounter::count();
+	const auto start = std::chrono::steady_clock::now();
+	for (const std::string &expression: expressions)
+	{
+		try
+		{
+			checksum += RPN::evaluate(expression);
+		}
+		catch (const std::exception &)
+		{
+			++pass.errors;
+		}
+	}
+	pass.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	pass.allocations = AllocationCounter::count() - before;
+	return pass;
+}
+
+int main(int argc, char **argv) {
+	size_t tokenBudget = 2000000;
+	int repeat = 3;
+	std::string operators = "+-*/";
+	unsigned seed = 42;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const std::string option = argv[i];
+		const std::string value = argv[i + 1];
+		if (option == "--tokens")
+			tokenBudget = std::strtoul(value.c_str(), nullptr, 10);
+		else if (option == "--repeat")
+			repeat = std::max(1, std::atoi(value.c_str()));
+		else if (option == "--operators")
+			operators = value;
+		else if (option == "--seed")
+			seed = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+		else
+		{
+			std::cerr << "Error: Unknown option " << option << std::endl;
+			return 1;
+		}
+	}
+	if (argc % 2 == 0)
+	{
+		std::cerr << "Error: Missing value for " << argv[argc - 1] << std::endl;
+		return 1;
+	}
+
+	std::cout << std::fixed << std::setprecision(3)
+			<< "depth,operands,operators,error_ratio,expressions,tokens,errors,evals_per_s,tokens_per_s,allocs_per_eval,"
+			"checksum" << std::endl;
+	for (const DepthProfile depth: { DepthProfile::Shallow, DepthProfile::Deep, DepthProfile::Balanced,
+	                                 DepthProfile::Random })
+	{
+		for (const size_t operands: { 3, 16, 256, 4096 })
+		{
+			for (const double errorRatio: { 0.0, 0.1 })
+			{
+				ExpressionProfile profile;
+				profile.operands = operands;
+				profile.operators = operators;
+				profile.depth = depth;
+				profile.errorRatio = errorRatio;
+
+				std::mt19937 rng(seed);
+				std::vector<std::string> expressions;
+				size_t tokens = 0;
+				while (tokens < tokenBudget)
+				{
+					expressions.push_back(ExpressionGenerator::generate(profile, rng));
+					tokens += ExpressionGenerator::countTokens(expressions.back());
+				}
+
+				long checksum = 0;
+				Pass best = evaluateAll(expressions, checksum); // warm-up
+				best.seconds = 1e300;
+				for (int run = 0; run < repeat; ++run)
+				{
+					const Pass pass = evaluateAll(expressions, checksum);
+					if (pass.seconds < best.seconds)
+						best = pass;
+				}
+
+				const double count = static_cast<double>(expressions.size());
+				std::cout << ExpressionGenerator::depthName(depth) << ',' << operands << ',' << operators << ','
+						<< errorRatio << ',' << expressions.size() << ',' << tokens << ',' << best.errors << ','
+						<< count / best.seconds << ',' << static_cast<double>(tokens) / best.seconds << ','
+						<< static_cast<double>(best.allocations) / count << ',' << checksum << std::endl;
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,507 @@
+#include <algorithm>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../ColumnEvaluator.hpp"
+#include "../RPN.hpp"
+#include "../TokenReader.hpp"
+#include "ExpressionGenerator.hpp"
+
+// Differential fuzzer: runs generated and mutated expressions through RPN::evaluate, the reference, and through
+// every other evaluation path, and reports each expression on which a path gives another result or error.
+// Expressions with variables are checked row by row over columns of bound values, against RPN::evaluate of the
+// expression with each variable replaced by its value in that row.
+// Usage: rpn_fuzz [--iterations N] [--seed N]. Exits with 1 if any path disagrees.
+
+#define FUZZ_USAGE "Usage: rpn_fuzz [--iterations N] [--seed N]"
+
+// Every this many iterations, an expression longer than a TokenReader chunk
+#define LONG_EXPRESSION_INTERVAL 997
+#define LONG_EXPRESSION_OPERANDS 30000
+
+// Rows bound to an expression with variables; every BLOCK_ROWS_INTERVAL expressions, more than a column block
+#define MAX_BOUND_ROWS 40
+#define BLOCK_ROWS_INTERVAL 101
+
+namespace {
+	struct Path {
+		const char *name;
+		// Sets outcome to the result or error message; false when the path cannot take this expression
+		std::function<bool(const std::string &expression, std::string &outcome)> run;
+		size_t checked = 0;
+		size_t mismatches = 0;
+	};
+
+	// The variables of an expression in order of first use, which is the order of RPN::compile's slots, and
+	// a column of rows values for each
+	struct Bindings {
+		std::vector<std::string> names;
+		std::vector<std::vector<int> > columns;
+		std::vector<const int *> pointers;
+		size_t rows = 0;
+
+		[[nodiscard]] std::vector<int> row(const size_t index) const {
+			std::vector<int> values;
+			for (const std::vector<int> &column: columns)
+				values.push_back(column[index]);
+			return values;
+		}
+	};
+
+	struct BoundPath {
+		const char *name;
+		// Sets outcomes[row] to the result or error message of every row
+		std::function<void(const std::string &expression, const Bindings &bindings,
+		                   std::vector<std::string> &outcomes)> run;
+		size_t checked = 0;
+		size_t mismatches = 0;
+	};
+}
+
+template<typename Evaluate>
+static std::string outcomeOf(Evaluate evaluate) {
+	try
+	{
+		return std::to_string(evaluate());
+	}
+	catch (const std::exception &e)
+	{
+		return e.what();
+	}
+}
+
+static bool isSpace(const char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static bool isIdentifier(const std::string_view token) {
+	for (size_t i = 0; i < token.size(); ++i)
+	{
+		const char c = token[i];
+		const bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+		if (!letter && (i == 0 || c < '0' || c > '9'))
+			return false;
+	}
+	return !token.empty();
+}
+
+// Calls visit(start, token) for every token of expression
+template<typename Visit>
+static void forEachToken(const std::string &expression, Visit visit) {
+	for (size_t i = 0; i < expression.size();)
+	{
+		if (isSpace(expression[i]))
+		{
+			++i;
+			continue;
+		}
+		size_t end = i;
+		while (end < expression.size() && !isSpace(expression[end]))
+			++end;
+		visit(i, std::string_view(expression).substr(i, end - i));
+		i = end;
+	}
+}
+
+// The identifiers of expression in order of first use, which compile() takes as variables where evaluate()
+// rejects them
+static std::vector<std::string> variablesOf(const std::string &expression) {
+	std::vector<std::string> names;
+	forEachToken(expression, [&names](size_t, const std::string_view token) {
+		if (isIdentifier(token) && std::find(names.begin(), names.end(), token) == names.end())
+			names.emplace_back(token);
+	});
+	return names;
+}
+
+// expression with every variable replaced by its value in row, for evaluate()
+static std::string substitute(const std::string &expression, const Bindings &bindings, const size_t row) {
+	std::string text;
+	size_t copied = 0;
+	forEachToken(expression, [&](const size_t start, const std::string_view token) {
+		if (!isIdentifier(token))
+			return;
+		const size_t slot = static_cast<size_t>(
+			std::find(bindings.names.begin(), bindings.names.end(), token) - bindings.names.begin());
+		text.append(expression, copied, start - copied);
+		text += std::to_string(bindings.columns[slot][row]);
+		copied = start + token.size();
+	});
+	text.append(expression, copied, std::string::npos);
+	return text;
+}
+
+// Values that break arithmetic most often, then small and arbitrary ones
+static int bindingValue(std::mt19937 &rng) {
+	static const int edges[] = { 0, 0, 1, -1, 2, -2, INT_MIN, INT_MIN + 1, INT_MAX };
+	switch (rng() % 10)
+	{
+		case 0:
+		case 1:
+		case 2:
+		case 3:
+			return edges[rng() % (sizeof(edges) / sizeof(edges[0]))];
+		case 4:
+		case 5:
+		case 6:
+			return std::uniform_int_distribution<int>(-9, 9)(rng);
+		default:
+			return static_cast<int>(rng());
+	}
+}
+
+static void bind(Bindings &bindings, const size_t rows, std::mt19937 &rng) {
+	bindings.rows = rows;
+	bindings.columns.assign(bindings.names.size(), std::vector<int>(rows));
+	bindings.pointers.clear();
+	for (std::vector<int> &column: bindings.columns)
+	{
+		for (int &value: column)
+			value = bindingValue(rng);
+		bindings.pointers.push_back(column.data());
+	}
+}
+
+// Compiles expression, or sets every outcome to the error compile() throws. False if there is nothing to run.
+static bool compileBound(const std::string &expression, const Bindings &bindings, RPN::Program &program,
+                         std::vector<std::string> &outcomes) {
+	try
+	{
+		program = RPN::compile(expression);
+	}
+	catch (const std::exception &e)
+	{
+		outcomes.assign(bindings.rows, e.what());
+		return false;
+	}
+	// A program that traps before the end has only the variables used up to there
+	const std::vector<std::string> &names = program.variables;
+	if (names.size() > bindings.names.size() || !std::equal(names.begin(), names.end(), bindings.names.begin()))
+	{
+		outcomes.assign(bindings.rows, "variables in another order than their first use");
+		return false;
+	}
+	return true;
+}
+
+static void executeRows(const RPN::Program &program, const Bindings &bindings, std::vector<std::string> &outcomes) {
+	outcomes.resize(bindings.rows);
+	for (size_t row = 0; row < bindings.rows; ++row)
+	{
+		const std::vector<int> values = bindings.row(row);
+		outcomes[row] = outcomeOf([&program, &values] { return RPN::execute(program, values.data()); });
+	}
+}
+
+static void evaluateColumns(const ColumnEvaluator::Kernel kernel, const RPN::Program &program,
+                            const Bindings &bindings, std::vector<std::string> &outcomes) {
+	std::vector<int> values(bindings.rows);
+	std::vector<ColumnEvaluator::Error> errors(bindings.rows);
+	ColumnEvaluator::evaluate(kernel, program, bindings.pointers.data(), bindings.rows, values.data(), errors.data());
+	outcomes.resize(bindings.rows);
+	for (size_t row = 0; row < bindings.rows; ++row)
+	{
+		outcomes[row] = errors[row] == ColumnEvaluator::Error::None ? std::to_string(values[row])
+			: ColumnEvaluator::errorMessage(program, errors[row]);
+	}
+}
+
+// Compiles expression, or sets outcome to the error compile() throws, which is the one evaluate() reports.
+// False for an expression with variables, which only the bound paths take.
+static bool compileLikeEvaluate(const std::string &expression, RPN::Program &program, std::string &outcome) {
+	outcome.clear();
+	if (!variablesOf(expression).empty())
+		return false;
+	try
+	{
+		program = RPN::compile(expression);
+	}
+	catch (const std::exception &e)
+	{
+		outcome = e.what();
+	}
+	return true;
+}
+
+static bool runColumns(const ColumnEvaluator::Kernel kernel, const std::string &expression, std::string &outcome) {
+	RPN::Program program;
+	if (!compileLikeEvaluate(expression, program, outcome))
+		return false;
+	if (!outcome.empty())
+		return true;
+	int value = 0;
+	ColumnEvaluator::Error error = ColumnEvaluator::Error::None;
+	ColumnEvaluator::evaluate(kernel, program, nullptr, 1, &value, &error);
+	outcome = error == ColumnEvaluator::Error::None ? std::to_string(value)
+		: ColumnEvaluator::errorMessage(program, error);
+	return true;
+}
+
+static std::string escape(const std::string &text) {
+	std::string escaped;
+	for (const char c: text)
+	{
+		if (c == '\t')
+			escaped += "\\t";
+		else if (c == '\n')
+			escaped += "\\n";
+		else if (c == '\v')
+			escaped += "\\v";
+		else if (c == '\f')
+			escaped += "\\f";
+		else if (c == '\r')
+			escaped += "\\r";
+		else
+			escaped += c;
+	}
+	return escaped.size() > 200 ? escaped.substr(0, 200) + "..." : escaped;
+}
+
+int main(int argc, char **argv) {
+	size_t iterations = 50000;
+	unsigned seed = 42;
+	for (int i = 1; i < argc; i += 2)
+	{
+		const std::string option = argv[i];
+		if (option != "--iterations" && option != "--seed")
+		{
+			std::cerr << "Error: Unknown option " << option << '\n' << FUZZ_USAGE << std::endl;
+			return 1;
+		}
+		if (i + 1 == argc)
+		{
+			std::cerr << "Error: Missing value for " << option << '\n' << FUZZ_USAGE << std::endl;
+			return 1;
+		}
+		if (option == "--iterations")
+			iterations = std::strtoul(argv[i + 1], nullptr, 10);
+		else
+			seed = static_cast<unsigned>(std::strtoul(argv[i + 1], nullptr, 10));
+	}
+
+	// evaluateStream reads a regular file through a mapping, and a pipe in chunks
+	char scratch[] = "/tmp/rpn_fuzz.XXXXXX";
+	const int file = mkstemp(scratch);
+	if (file == -1)
+	{
+		std::perror("Error: mkstemp");
+		return 1;
+	}
+	unlink(scratch);
+	std::signal(SIGPIPE, SIG_IGN);
+
+	std::vector<Path> paths;
+	paths.push_back({ "execute", [](const std::string &expression, std::string &outcome) {
+		RPN::Program program;
+		if (!compileLikeEvaluate(expression, program, outcome))
+			return false;
+		if (outcome.empty())
+			outcome = outcomeOf([&program] { return RPN::execute(program); });
+		return true;
+	} });
+	paths.push_back({ "optimize", [](const std::string &expression, std::string &outcome) {
+		RPN::Program program;
+		if (!compileLikeEvaluate(expression, program, outcome))
+			return false;
+		if (outcome.empty())
+		{
+			RPN::optimize(program);
+			outcome = outcomeOf([&program] { return RPN::execute(program); });
+		}
+		return true;
+	} });
+	for (const ColumnEvaluator::Kernel kernel: { ColumnEvaluator::Kernel::Scalar, ColumnEvaluator::Kernel::Avx2 })
+	{
+		if (ColumnEvaluator::isSupported(kernel))
+		{
+			paths.push_back({ kernel == ColumnEvaluator::Kernel::Avx2 ? "columns-avx2" : "columns-scalar",
+			                  [kernel](const std::string &expression, std::string &outcome) {
+				                  return runColumns(kernel, expression, outcome);
+			                  } });
+		}
+	}
+	paths.push_back({ "stream-mmap", [file](const std::string &expression, std::string &outcome) {
+		if (ftruncate(file, 0) != 0 || lseek(file, 0, SEEK_SET) != 0
+		    || write(file, expression.data(), expression.size()) != static_cast<ssize_t>(expression.size()))
+			return false;
+		TokenReader reader(file);
+		outcome = outcomeOf([&reader] { return RPN::evaluateStream(reader); });
+		return true;
+	} });
+	paths.push_back({ "stream-pipe", [](const std::string &expression, std::string &outcome) {
+		int ends[2];
+		if (pipe(ends) != 0)
+			return false;
+		std::thread writer([&expression, &ends] {
+			for (size_t written = 0; written < expression.size();)
+			{
+				const ssize_t n = write(ends[1], expression.data() + written, expression.size() - written);
+				if (n <= 0)
+					break;
+				written += static_cast<size_t>(n);
+			}
+			close(ends[1]);
+		});
+		{
+			TokenReader reader(ends[0]);
+			outcome = outcomeOf([&reader] { return RPN::evaluateStream(reader); });
+		}
+		close(ends[0]); // stops the writer if evaluateStream stopped at an error
+		writer.join();
+		return true;
+	} });
+	paths.push_back({ "batch", [](const std::string &expression, std::string &outcome) {
+		if (expression.find('\n') != std::string::npos)
+			return false;
+		std::istringstream input(expression + "\n");
+		std::ostringstream output;
+		RPN::evaluateLines(input, output, 1);
+		outcome = output.str();
+		if (!outcome.empty())
+			outcome.pop_back();
+		return true;
+	} });
+
+	std::vector<BoundPath> boundPaths;
+	boundPaths.push_back({ "bound-execute", [](const std::string &expression, const Bindings &bindings,
+	                                           std::vector<std::string> &outcomes) {
+		RPN::Program program;
+		if (compileBound(expression, bindings, program, outcomes))
+			executeRows(program, bindings, outcomes);
+	} });
+	boundPaths.push_back({ "bound-optimize", [](const std::string &expression, const Bindings &bindings,
+	                                            std::vector<std::string> &outcomes) {
+		RPN::Program program;
+		if (!compileBound(expression, bindings, program, outcomes))
+			return;
+		RPN::optimize(program);
+		executeRows(program, bindings, outcomes);
+	} });
+	for (const ColumnEvaluator::Kernel kernel: { ColumnEvaluator::Kernel::Scalar, ColumnEvaluator::Kernel::Avx2 })
+	{
+		if (!ColumnEvaluator::isSupported(kernel))
+			continue;
+		const bool avx2 = kernel == ColumnEvaluator::Kernel::Avx2;
+		boundPaths.push_back({ avx2 ? "bound-columns-avx2" : "bound-columns-scalar",
+		                       [kernel](const std::string &expression, const Bindings &bindings,
+		                                std::vector<std::string> &outcomes) {
+			                       RPN::Program program;
+			                       if (compileBound(expression, bindings, program, outcomes))
+				                       evaluateColumns(kernel, program, bindings, outcomes);
+		                       } });
+		boundPaths.push_back({ avx2 ? "bound-optimize-columns-avx2" : "bound-optimize-columns-scalar",
+		                       [kernel](const std::string &expression, const Bindings &bindings,
+		                                std::vector<std::string> &outcomes) {
+			                       RPN::Program program;
+			                       if (!compileBound(expression, bindings, program, outcomes))
+				                       return;
+			                       RPN::optimize(program);
+			                       evaluateColumns(kernel, program, bindings, outcomes);
+		                       } });
+	}
+
+	std::mt19937 rng(seed);
+	static const char *const mixes[] = { "+-*/", "+-*/", "/", "*/", "+-", "-" };
+	static const size_t operandCounts[] = { 1, 2, 3, 4, 5, 8, 16, 64 };
+	static const int maxLiterals[] = { 1, 9, 100, 2147483647 };
+	size_t generated = 0;
+	size_t bound = 0;
+	std::string expected;
+	std::string outcome;
+	Bindings bindings;
+	std::vector<std::string> expectedRows;
+	std::vector<std::string> outcomes;
+	for (size_t i = 0; i < iterations; ++i)
+	{
+		ExpressionProfile profile;
+		profile.operands = operandCounts[rng() % 8];
+		profile.operators = mixes[rng() % 6];
+		profile.depth = static_cast<DepthProfile>(rng() % 4);
+		profile.errorRatio = 0.2;
+		profile.maxLiteral = maxLiterals[rng() % 4];
+		profile.variables = rng() % 4;
+		if (i % LONG_EXPRESSION_INTERVAL == LONG_EXPRESSION_INTERVAL - 1)
+		{
+			profile.operands = LONG_EXPRESSION_OPERANDS;
+			profile.maxLiteral = 2147483647;
+		}
+
+		std::string expression = ExpressionGenerator::generate(profile, rng);
+		if (rng() % 2 == 0)
+			expression = ExpressionGenerator::mutate(expression, rng);
+		else
+			++generated;
+
+		expected = outcomeOf([&expression] { return RPN::evaluate(expression); });
+		for (Path &path: paths)
+		{
+			if (!path.run(expression, outcome))
+				continue;
+			++path.checked;
+			if (outcome != expected && path.mismatches++ < 5)
+			{
+				std::cout << path.name << " [" << escape(expression) << "]: " << escape(outcome) << ", expected "
+						<< escape(expected) << std::endl;
+			}
+		}
+
+		bindings.names = variablesOf(expression);
+		if (bindings.names.empty())
+			continue;
+		const bool longExpression = profile.operands == LONG_EXPRESSION_OPERANDS;
+		const size_t rows = ++bound % BLOCK_ROWS_INTERVAL == 0 && !longExpression
+			? COLUMN_BLOCK_ROWS + 1 + rng() % MAX_BOUND_ROWS
+			: 1 + rng() % MAX_BOUND_ROWS;
+		bind(bindings, rows, rng);
+		expectedRows.resize(rows);
+		for (size_t row = 0; row < rows; ++row)
+		{
+			const std::string substituted = substitute(expression, bindings, row);
+			expectedRows[row] = outcomeOf([&substituted] { return RPN::evaluate(substituted); });
+		}
+		for (BoundPath &path: boundPaths)
+		{
+			path.run(expression, bindings, outcomes);
+			for (size_t row = 0; row < rows; ++row)
+			{
+				++path.checked;
+				if (outcomes[row] == expectedRows[row] || path.mismatches++ >= 5)
+					continue;
+				std::cout << path.name << " [" << escape(expression) << "] with";
+				for (size_t slot = 0; slot < bindings.names.size(); ++slot)
+					std::cout << ' ' << bindings.names[slot] << '=' << bindings.columns[slot][row];
+				std::cout << ": " << escape(outcomes[row]) << ", expected " << escape(expectedRows[row]) << std::endl;
+			}
+		}
+	}
+	close(file);
+
+	bool agree = true;
+	std::cout << iterations << " expressions, " << generated << " generated, " << iterations - generated
+			<< " mutated, " << bound << " with variables" << std::endl;
+	for (const Path &path: paths)
+	{
+		std::cout << path.name << ": " << path.checked << " checked, " << path.mismatches << " mismatches"
+				<< std::endl;
+		agree = agree && path.mismatches == 0;
+	}
+	for (const BoundPath &path: boundPaths)
+	{
+		std::cout << path.name << ": " << path.checked << " rows checked, " << path.mismatches << " mismatches"
+				<< std::endl;
+		agree = agree && path.mismatches == 0;
+	}
+	return agree ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "ExpressionGenerator.hpp"
+
+// Writes generated RPN expressions to stdout, one per line, ready for RPN --batch
+
+static void printUsage(const char *program) {
+	std::cerr << "Usage: " << program << " [options]\n"
+			<< "  --count N           expressions to write (default 1000)\n"
+			<< "  --operands N        operands per expression (default 16)\n"
+			<< "  --operators MIX     operators drawn uniformly from MIX (default +-*/)\n"
+			<< "  --depth PROFILE     shallow, deep, balanced or random (default random)\n"
+			<< "  --error-ratio R     share of invalid expressions (default 0)\n"
+			<< "  --max-literal N     largest literal (default 9)\n"
+			<< "  --seed N            random seed (default 42)" << std::endl;
+}
+
+static bool parseNumber(const std::string &text, double &number) {
+	char *end = nullptr;
+	number = std::strtod(text.c_str(), &end);
+	return !text.empty() && *end == '\0' && number >= 0;
+}
+
+int main(int argc, char **argv) {
+	ExpressionProfile profile;
+	size_t count = 1000;
+	unsigned seed = 42;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string option = argv[i];
+		if (i + 1 >= argc)
+		{
+			printUsage(argv[0]);
+			return 1;
+		}
+		const std::string value = argv[++i];
+		double number = 0;
+		bool valid = true;
+		if (option == "--depth")
+			valid = ExpressionGenerator::parseDepth(value, profile.depth);
+		else if (option == "--operators")
+		{
+			profile.operators = value;
+			valid = !value.empty() && value.find_first_not_of("+-*/") == std::string::npos;
+		}
+		else if (parseNumber(value, number))
+		{
+			if (option == "--count")
+				count = static_cast<size_t>(number);
+			else if (option == "--operands")
+				profile.operands = static_cast<size_t>(number);
+			else if (option == "--error-ratio")
+				profile.errorRatio = number;
+			else if (option == "--max-literal")
+			{
+				valid = number <= 2147483647;
+				profile.maxLiteral = valid ? static_cast<int>(number) : 0;
+			}
+			else if (option == "--seed")
+				seed = static_cast<unsigned>(number);
+			else
+				valid = false;
+		}
+		else
+			valid = false;
+		if (!valid)
+		{
+			std::cerr << "Error: Invalid value for " << option << ": " << value << std::endl;
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	std::ios::sync_with_stdio(false);
+	std::mt19937 rng(seed);
+	for (size_t i = 0; i < count; ++i)
+		std::cout << ExpressionGenerator::generate(profile, rng) << '\n';
+	std::cout.flush();
+	return 0;
+}
@@ -1,8 +1,99 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <thread>
 #include "RPN.hpp"
+#include "TokenReader.hpp"
+
+// RPN --batch [FILE | -] [--threads N]: one expression per line, one result or error per line on stdout
+static int runBatch(const int argc, char** argv)
+{
+	const char* path = "-";
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	for (int i = 2; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			const char* count = argv[++i];
+			const char* countEnd = count + std::strlen(count);
+			const std::from_chars_result result = std::from_chars(count, countEnd, threads);
+			if (result.ec != std::errc() || result.ptr != countEnd || threads == 0)
+			{
+				std::cerr << "Error: invalid thread count: " << count << std::endl;
+				return 1;
+			}
+		}
+		else if (i == 2 && argv[i][0] != '\0')
+		{
+			path = argv[i];
+		}
+		else
+		{
+			std::cerr << "Error" << std::endl;
+			return 1;
+		}
+	}
+
+	std::ifstream file;
+	if (std::strcmp(path, "-") != 0)
+	{
+		file.open(path);
+		if (!file)
+		{
+			std::cerr << "Error: could not open file " << path << std::endl;
+			return 1;
+		}
+	}
+	std::istream& input = file.is_open() ? file : std::cin;
+
+	std::ios::sync_with_stdio(false);
+	const auto start = std::chrono::steady_clock::now();
+	const size_t count = RPN::evaluateLines(input, std::cout, threads);
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cerr << count << " expressions in " << seconds << " s on " << threads << " threads ("
+			<< static_cast<double>(count) / seconds << " expressions/s)" << std::endl;
+	return 0;
+}
+
+// RPN --stream [FILE | -]: the whole input is one expression, however large, with newlines as spaces
+static int runStream(const int argc, char** argv)
+{
+	if (argc > 3)
+	{
+		std::cerr << "Error" << std::endl;
+		return 1;
+	}
+	const char* path = argc == 3 ? argv[2] : "-";
+	TokenReader reader(path);
+	if (!reader.isOpen())
+	{
+		std::cerr << "Error: could not open file " << path << std::endl;
+		return 1;
+	}
+
+	try
+	{
+		const int result = RPN::evaluateStream(reader);
+		std::cout << result << std::endl;
+	}
+	catch (const RPN::StreamError& e)
+	{
+		std::cerr << e.what() << " (at byte " << e.offset() << ")" << std::endl;
+		return 1;
+	}
+	return 0;
+}
 
 int main(const int argc, char** argv)
 {
+	if (argc >= 2 && std::strcmp(argv[1], "--batch") == 0)
+		return runBatch(argc, argv);
+	if (argc >= 2 && std::strcmp(argv[1], "--stream") == 0)
+		return runStream(argc, argv);
+
 	if (argc != 2)
 	{
 		std::cerr << "Error" << std::endl;
@@ -1,42 +1,77 @@
 #include "PmergeMe.hpp"
 
+#include <array>
+#include <chrono>
+#include <cmath>
 #include <deque>
 #include <iostream>
-#include <vector>
-#include <cmath>
 #include <numeric>
+#include <vector>
+
+Element::Element(int data, const int depth) : _maxValue(data), _depth(depth) {
+}
+
+Element::Element(const ElementId first, const ElementId second, const int depth, const int maxValue)
+	: _maxValue(maxValue), _first(first), _second(second), _depth(depth) {
+}
+
 
-Element::Element(int data, const int depth) : _data(data), _depth(depth) {
+ElementId makeElement(int data) {
+	return elementArena.make(data);
 }
 
-Element::Element(const std::shared_ptr<Element> &first, const std::shared_ptr<Element> &second, const int depth)
-	: _data(Pair(first, second)), _depth(depth) {
+ElementId merge(const ElementId first, const ElementId second) {
+	const int depth = std::max(elementArena[first]._depth, elementArena[second]._depth) + 1;
+	return elementArena.make(first, second, depth);
 }
 
-int Element::getMaxValue() const {// NOLINT(*-no-recursion)
-	if (std::holds_alternative<int>(_data)) {
-		return std::get<int>(_data); // Base Case
+void ElementArena::reset(const size_t expectedNodes) {
+	_elements.clear();
+	_stats.nodes = 0;
+	if (expectedNodes > _elements.capacity()) {
+		_elements.reserve(expectedNodes);
+		++_stats.blocks;
 	}
-	const auto &[first, second] = std::get<Pair>(_data);
-	return second->getMaxValue();
+	_stats.bytes = _elements.capacity() * sizeof(Element);
+	_stats.peakBytes = std::max(_stats.peakBytes, _stats.bytes);
 }
 
+void ElementArena::release() {
+	std::vector<Element>().swap(_elements);
+	_stats.bytes = 0;
+}
 
-std::shared_ptr<Element> makeElement(int data) {
-	return std::make_shared<Element>(data);
+ElementId ElementArena::added() {
+	_stats.nodes = _elements.size();
+	_stats.peakNodes = std::max(_stats.peakNodes, _stats.nodes);
+	const size_t bytes = _elements.capacity() * sizeof(Element);
+	if (bytes != _stats.bytes) {
+		++_stats.blocks; // outgrew the reserved block
+		_stats.bytes = bytes;
+		_stats.peakBytes = std::max(_stats.peakBytes, bytes);
+	}
+	return static_cast<ElementId>(_elements.size() - 1);
 }
 
-std::shared_ptr<Element> merge(const std::shared_ptr<Element> &first, const std::shared_ptr<Element> &second) {
-	const int depth = std::max(first->_depth, second->_depth) + 1;
-	return std::make_shared<Element>(first, second, depth);
+ElementId ElementArena::make(const int data) {
+	_elements.emplace_back(data);
+	return added();
+}
+
+ElementId ElementArena::make(const ElementId first, const ElementId second, const int depth) {
+	// Read before emplace_back, which may move the elements
+	const int maxValue = _elements[second].getMaxValue();
+	_elements.emplace_back(first, second, depth, maxValue);
+	return added();
 }
 
 void Element::sortElement() {
-	if (std::holds_alternative<int>(_data)) return;
+	if (!isPair()) return;
 
-	if (auto &[first, second] = std::get<Pair>(_data); first->getMaxValue() > second->getMaxValue()) {
-		printSwap(first, second);
-		std::swap(first, second);
+	if (elementArena[_first].getMaxValue() > elementArena[_second].getMaxValue()) {
+		printSwap(_first, _second);
+		std::swap(_first, _second);
+		_maxValue = elementArena[_second].getMaxValue();
 	}
 }
 
@@ -44,9 +79,14 @@ inline int PmergeMe::getGlobalComparisonCount() {
 	return globalComparisonCount;
 }
 
+const ElementArena::Stats &PmergeMe::getArenaStats() {
+	return elementArena.stats();
+}
+
 int PmergeMe::runVector(const std::vector<int> &input, const bool _printDebug) {
 	printDebug = _printDebug;
-	std::vector<std::shared_ptr<Element> > elements;
+	elementArena.reset(ElementArena::nodesFor(input.size()));
+	std::vector<ElementId> elements;
 
 	const auto start = std::chrono::high_resolution_clock::now();
 	parseInput(elements, input);
@@ -57,18 +97,21 @@ int PmergeMe::runVector(const std::vector<int> &input, const bool _printDebug) {
 	const std::chrono::duration<double, std::micro> elapsed = end - start;
 	std::cout << "Time to process a range of " << elements.size() << " elements with std::vector : " << elapsed.count()
 			<< " us" << std::endl;
+	elementArena.release(); // every element of the run at once
 	return globalComparisonCount;
 }
 
 int PmergeMe::runDeque(const std::vector<int> &input, const bool _printDebug) {
 	printDebug = _printDebug;
-	std::deque<std::shared_ptr<Element> > elements;
+	elementArena.reset(ElementArena::nodesFor(input.size()));
+	std::deque<ElementId> elements;
 
 	parseInput(elements, input);
 
 	std::cout << "Before : ";
 	printAllElements(elements, true);
 	elements.clear();
+	elementArena.reset(ElementArena::nodesFor(input.size()));
 
 	const auto start = std::chrono::high_resolution_clock::now();
 	parseInput(elements, input);
@@ -82,6 +125,7 @@ int PmergeMe::runDeque(const std::vector<int> &input, const bool _printDebug) {
 	printAllElements(elements, true);
 	std::cout << "Time to process a range of " << elements.size() << " elements with std::deque : " << elapsed.count()
 			<< " us" << std::endl;
+	elementArena.release(); // every element of the run at once
 
 	return globalComparisonCount;
 }
@@ -135,16 +179,15 @@ size_t PmergeMe::getBoundary(const std::vector<size_t> &indices, size_t value) {
 	return -1;
 }
 
-#pragma region Print functions
-void PmergeMe::printInsertion(const std::shared_ptr<Element> &elem, const size_t idx,
-                              const std::shared_ptr<Element> &boundaryElem, const size_t boundaryIdx,
-                              const std::string &prefix) {
+// region Print functions
+void PmergeMe::printInsertion(const ElementId elem, const size_t idx, const ElementId boundaryElem,
+                              const size_t boundaryIdx, const std::string &prefix) {
 	if (!printDebug) return;
 	std::cout << prefix << "Insert elem b" << idx + 2 << " ";
-	elem->print(0);
+	elementArena[elem].print(0);
 	std::cout << "from pend idx(" << idx << ") with boundary ";
-	if (boundaryElem) {
-		boundaryElem->print(0);
+	if (boundaryElem != noElement) {
+		elementArena[boundaryElem].print(0);
 	}
 	std::cout << "idx " << boundaryIdx << std::endl;
 }
@@ -162,40 +205,36 @@ void Element::print(const int i, const bool overridePrint) const {// NOLINT(*-no
 	};
 	static auto resetColor = "\033[0m";
 
-	if (std::holds_alternative<int>(_data)) {
-		std::cout << colors[i % colors.size()] << std::get<int>(_data) << resetColor << " ";
-	} else if (std::holds_alternative<Pair>(_data)) {
-		const auto &[first, second] = std::get<Pair>(_data);
-
-		// Validate pointers
-		if (!first || !second) {
-			std::cerr << colors[i % colors.size()] << "Invalid Pair: Null pointer detected" << resetColor << "\n";
+	if (!isPair()) {
+		std::cout << colors[i % colors.size()] << _maxValue << resetColor << " ";
+	} else {
+		// Validate indices
+		if (_first >= elementArena.size() || _second >= elementArena.size()) {
+			std::cerr << colors[i % colors.size()] << "Invalid Pair: Unknown element detected" << resetColor << "\n";
 			return;
 		}
 
 		std::cout << colors[i % colors.size()] << "( ";
-		first->print(i);
-		second->print(i);
+		elementArena[_first].print(i);
+		elementArena[_second].print(i);
 		std::cout << colors[i % colors.size()] << ")" << resetColor;
-	} else {
-		std::cerr << colors[i % colors.size()] << "Unsupported type in _data" << resetColor << "\n";
 	}
 }
 
-void Element::printSwap(const std::shared_ptr<Element> &first, const std::shared_ptr<Element> &second) {
+void Element::printSwap(const ElementId first, const ElementId second) {
 	++globalComparisonCount;
 	if (!printDebug) return;
 	std::cout << "Swapping elements: ";
-	first->print(0);
+	elementArena[first].print(0);
 	std::cout << " and ";
-	second->print(0);
+	elementArena[second].print(0);
 	std::cout << std::endl;
 }
 
-void PmergeMe::printOddInsertion(const std::shared_ptr<Element> &odd) {
+void PmergeMe::printOddInsertion(const ElementId odd) {
 	if (printDebug) {
 		std::cout << "O -> Insert elem ";
-		odd->print(0);
+		elementArena[odd].print(0);
 		std::cout << " into main chain" << std::endl;
 	}
 }
@@ -213,4 +252,4 @@ void PmergeMe::printJacobsthalIndices(const std::vector<size_t> &jacobIndices) {
 		}
 	}
 }
-#pragma endregion
+// endregion
@@ -1,38 +1,91 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
 #include <deque>
 #include <iostream>
 #include <numeric>
-#include <variant>
+#include <string>
 #include <vector>
 
-struct Element;
+// Index of an Element in elementArena
+using ElementId = uint32_t;
+
+inline constexpr ElementId noElement = UINT32_MAX;
 
 inline int globalComparisonCount = 0;
 
 inline bool printDebug = false;
 
-using Pair = std::pair<std::shared_ptr<Element>, std::shared_ptr<Element> >;
-
+// A number, or a pair of two elements of the same depth, stored by index in elementArena so that a run
+// allocates one contiguous array instead of a refcounted object per node
 struct Element {
-	std::variant<int, Pair> _data;
+	int _maxValue = 0; // the number itself, or for a pair the _maxValue of _second, kept by sortElement()
+	ElementId _first = noElement; // the smaller of a pair, once sortElement() ran
+	ElementId _second = noElement; // the bigger of a pair
 	int _depth = 0;
 
 	explicit Element(int data, int depth = 0);
 
-	explicit Element(const std::shared_ptr<Element> &first, const std::shared_ptr<Element> &second, int depth);
+	explicit Element(ElementId first, ElementId second, int depth, int maxValue);
+
+	[[nodiscard]] bool isPair() const { return _first != noElement; }
 
-	[[nodiscard]] int getMaxValue() const;
+	[[nodiscard]] int getMaxValue() const { return _maxValue; }
 
 	void print(int i, bool overridePrint = false) const;
 
-	static void printSwap(const std::shared_ptr<Element> &first, const std::shared_ptr<Element> &second);
+	static void printSwap(ElementId first, ElementId second);
 
 	void sortElement();
 };
 
-std::shared_ptr<Element> makeElement(int data);
+// Owns every Element of a run in one block, handed out as ElementIds: indices stay valid when the block grows,
+// and the whole run is dropped at once instead of node by node
+class ElementArena {
+public:
+	struct Stats {
+		size_t nodes = 0; // elements handed out since the last reset
+		size_t peakNodes = 0; // most elements held at once, over every run
+		size_t bytes = 0; // memory reserved for elements right now
+		size_t peakBytes = 0; // over every run
+		size_t blocks = 0; // times the block was allocated or moved, over every run; one per run when sized right
+	};
+
+private:
+	std::vector<Element> _elements;
+	Stats _stats;
+
+	ElementId added();
+
+public:
+	// Elements a run over count numbers makes at most: count numbers and count - 1 pairs
+	static size_t nodesFor(const size_t count) { return count == 0 ? 0 : 2 * count - 1; }
+
+	// Drops every element, keeping room for expectedNodes of them
+	void reset(size_t expectedNodes);
+
+	// Drops every element and frees their memory
+	void release();
+
+	ElementId make(int data);
+
+	ElementId make(ElementId first, ElementId second, int depth);
+
+	Element &operator[](const ElementId id) { return _elements[id]; }
+
+	const Element &operator[](const ElementId id) const { return _elements[id]; }
+
+	[[nodiscard]] size_t size() const { return _elements.size(); }
+
+	[[nodiscard]] const Stats &stats() const { return _stats; }
+};
+
+// Every element of the current run
+inline ElementArena elementArena;
 
-std::shared_ptr<Element> merge(const std::shared_ptr<Element> &first, const std::shared_ptr<Element> &second);
+ElementId makeElement(int data);
+
+ElementId merge(ElementId first, ElementId second);
 
 class PmergeMe {
 	template<typename T>
@@ -42,7 +95,7 @@ class PmergeMe {
 	static void printAllElements(const T &elements, bool overridePrint = false);
 
 	template<typename T>
-	static void printChains(const T &mainChain, const T &pendingChain, const std::shared_ptr<Element> &odd,
+	static void printChains(const T &mainChain, const T &pendingChain, ElementId odd,
 	                        const T &rest);
 
 	template<typename T>
@@ -61,17 +114,16 @@ class PmergeMe {
 	static void processPendingChain(T &mainChain, T &pendingChain);
 
 	template<typename T>
-	static void handleOddElement(T &mainChain, std::shared_ptr<Element> odd);
+	static void handleOddElement(T &mainChain, ElementId odd);
 
 	static void printJacobsthalIndices(const std::vector<size_t> &jacobIndices);
 
-	static void printOddInsertion(const std::shared_ptr<Element> &odd);
+	static void printOddInsertion(ElementId odd);
 
 	static size_t getBoundary(const std::vector<size_t> &indices, size_t value);
 
-	static void printInsertion(const std::shared_ptr<Element> &elem, size_t idx,
-	                           const std::shared_ptr<Element> &boundaryElem,
-	                           size_t boundaryIdx, const std::string &prefix = "     ");
+	static void printInsertion(ElementId elem, size_t idx, ElementId boundaryElem, size_t boundaryIdx,
+	                           const std::string &prefix = "     ");
 
 	template<typename T>
 	static T sort(T &elements, T &rest);
@@ -83,11 +135,11 @@ class PmergeMe {
 	static void swapPairs(T &elements, T &rest);
 
 	template<typename T>
-	static void splitElementsIntoChains(const T &elements, T &mainChain, T &pendingChain, std::shared_ptr<Element> &odd,
+	static void splitElementsIntoChains(const T &elements, T &mainChain, T &pendingChain, ElementId &odd,
 	                                    T &rest);
 
 	template<class T>
-	static typename T::iterator sortElementIntoChain(const std::shared_ptr<Element> &elem, T &mainChain,
+	static typename T::iterator sortElementIntoChain(ElementId elem, T &mainChain,
 	                                                 typename T::iterator endBoundary);
 
 public:
@@ -103,6 +155,9 @@ public:
 
 	static int getGlobalComparisonCount();
 
+	// Arena usage so far, to size it
+	static const ElementArena::Stats &getArenaStats();
+
 	static int runVector(const std::vector<int> &input, bool _printDebug = false);
 
 	static int runDeque(const std::vector<int> &input, bool _printDebug = false);
@@ -167,8 +222,8 @@ void PmergeMe::processPendingChain(T &mainChain, T &pendingChain) {
 }
 
 template<typename T>
-void PmergeMe::handleOddElement(T &mainChain, std::shared_ptr<Element> odd) {
-	if (!odd) return;
+void PmergeMe::handleOddElement(T &mainChain, const ElementId odd) {
+	if (odd == noElement) return;
 	printOddInsertion(odd);
 	sortElementIntoChain(odd, mainChain, mainChain.end());
 }
@@ -182,7 +237,7 @@ T PmergeMe::sort(T &elements, T &rest) {
 
 	T mainChain;
 	T pendingChain;
-	std::shared_ptr<Element> odd;
+	ElementId odd = noElement;
 
 	// Split elements into main chain, pending chain, odd element and rest
 	splitElementsIntoChains(elements, mainChain, pendingChain, odd, rest);
@@ -232,24 +287,23 @@ bool PmergeMe::mergePairs(T &elements, T &rest) {
 
 template<typename T>
 void PmergeMe::swapPairs(T &elements, T &rest) {
-	for (const auto &element: elements) {
-		element->sortElement();
+	for (const ElementId element: elements) {
+		elementArena[element].sortElement();
 	}
-	printChains(elements, {}, nullptr, rest);
+	printChains(elements, {}, noElement, rest);
 }
 
 template<typename T>
 void PmergeMe::splitElementsIntoChains(const T &elements, T &mainChain,
-                                       T &pendingChain, std::shared_ptr<Element> &odd, T &rest) {
+                                       T &pendingChain, ElementId &odd, T &rest) {
 	bool isFirstPair = true;
 
-	for (auto &elem: elements) {
-		if (std::holds_alternative<int>(elem->_data)) {
+	for (const ElementId elem: elements) {
+		if (!elementArena[elem].isPair()) {
 			mainChain.push_back(elem);
 		} else {
-			auto &pairRef = std::get<Pair>(elem->_data);
-			auto &left = pairRef.first; // should be the smaller one if swapPairs() was called
-			auto &right = pairRef.second; // should be the bigger one
+			const ElementId left = elementArena[elem]._first; // should be the smaller one if swapPairs() was called
+			const ElementId right = elementArena[elem]._second; // should be the bigger one
 
 			if (isFirstPair) {
 				mainChain.push_back(left);
@@ -262,62 +316,62 @@ void PmergeMe::splitElementsIntoChains(const T &elements, T &mainChain,
 		}
 	}
 
-	if (!rest.empty() && rest.back()->_depth == mainChain.back()->_depth) {
+	if (!rest.empty() && elementArena[rest.back()]._depth == elementArena[mainChain.back()]._depth) {
 		odd = rest.back();
 		rest.pop_back();
 	}
 }
 
 template<typename T>
-typename T::iterator PmergeMe::sortElementIntoChain(const std::shared_ptr<Element> &elem, T &mainChain,
+typename T::iterator PmergeMe::sortElementIntoChain(const ElementId elem, T &mainChain,
                                                     typename T::iterator endBoundary) {
 	auto it = std::upper_bound(
-		mainChain.begin(), endBoundary, elem, [](const std::shared_ptr<Element> &a, const std::shared_ptr<Element> &b) {
+		mainChain.begin(), endBoundary, elem, [](const ElementId a, const ElementId b) {
 			++globalComparisonCount;
-			return a->getMaxValue() < b->getMaxValue();
+			return elementArena[a].getMaxValue() < elementArena[b].getMaxValue();
 		});
 
 	return mainChain.insert(it, elem);
 }
 
-#pragma region Print functions
+// region Print functions
 template<typename T>
 void PmergeMe::printAllElements(const T &elements, bool overridePrint) {
 	if (!printDebug && !overridePrint) return;
 	for (size_t i = 0; i < elements.size(); ++i) {
-		elements[i]->print(i);
+		elementArena[elements[i]].print(i);
 	}
 	std::cout << std::endl;
 }
 
 template<typename T>
-void PmergeMe::printChains(const T &mainChain, const T &pendingChain, const std::shared_ptr<Element> &odd,
+void PmergeMe::printChains(const T &mainChain, const T &pendingChain, const ElementId odd,
                            const T &rest) {
 	if (!printDebug) return;
 	std::cout << std::endl;
 	std::cout << "Main: ";
 	for (size_t i = 0; i < mainChain.size(); ++i) {
-		mainChain[i]->print(i);
+		elementArena[mainChain[i]].print(i);
 	}
 
 	if (!pendingChain.empty()) {
 		std::cout << " | Pend: ";
 		for (size_t i = 0; i < pendingChain.size(); ++i) {
-			pendingChain[i]->print(i);
+			elementArena[pendingChain[i]].print(i);
 		}
 	}
-	if (odd) {
+	if (odd != noElement) {
 		std::cout << " | Odd: ";
-		odd->print(0);
+		elementArena[odd].print(0);
 	}
 
 	if (!rest.empty()) {
 		std::cout << " | Rest: ";
 		for (size_t i = 0; i < rest.size(); ++i) {
-			rest[rest.size() - 1 - i]->print(i);
+			elementArena[rest[rest.size() - 1 - i]].print(i);
 		}
 	}
 	std::cout << std::endl;
 }
 
-#pragma endregion
+// endregion